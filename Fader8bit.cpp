@@ -3,10 +3,14 @@
 // How many steps are in a fade in/out?
 #define NUMSTEPS 80
 
-Fader8bit::Fader8bit(Adafruit_NeoPixel *s)
+#ifndef FADER8BIT_SOA
+// The packed-bitmap backend (cf. Fader8bitSoA.cpp)
+
+Fader8bit::Fader8bit(Adafruit_NeoPixel *s, uint16_t firstPixel, uint8_t numPixels)
 {
   this->strip = s;
-  this->numPixels = s->numPixels();
+  this->firstPixel = firstPixel;
+  this->numPixels = numPixels ? numPixels : min(s->numPixels() - firstPixel, 255);
   this->fadingBits = (uint8_t*)malloc((this->numPixels/8)+1);
   this->fadeDirectionBits = (uint8_t*)malloc((this->numPixels/8)+1);
   this->targetColor = (uint8_t*)malloc(this->numPixels);
@@ -14,6 +18,7 @@ Fader8bit::Fader8bit(Adafruit_NeoPixel *s)
   for (int i=0; i<(this->numPixels/8)+1; i++) {
     this->fadingBits[i] = 0;
   }
+  this->numFading = 0;
   this->nextMillis = 0;
 }
 
@@ -35,6 +40,11 @@ void Fader8bit::reset()
   }
 }
 
+void Fader8bit::brightnessChanged()
+{
+  // We read the strip back every step anyway
+}
+
 bool Fader8bit::isFading(uint8_t pixelNum)
 {
   uint8_t idx = pixelNum / 8;
@@ -49,21 +59,15 @@ void Fader8bit::setFading(uint8_t pixelNum,
   uint8_t idx = pixelNum / 8;
   uint8_t bitNum = pixelNum % 8;
 
+  if (!isFading(pixelNum)) {
+    this->numFading++;
+  }
   this->fadingBits[idx] |= (1 << bitNum);        // Yes, we are fading;
   this->fadeDirectionBits[idx] |= (1 << bitNum); // and we are increasing.
 
   this->targetColor[pixelNum] = reduceColorTo8bit(r, g, b); // calc target color
 
-  this->strip->setPixelColor(pixelNum, 0); // fade in from black
-}
-
-void Fader8bit::setFading(uint8_t pixelNum, uint32_t c)
-{
-  uint8_t r, g, b;
-  r = (c >> 16) & 0xFF;
-  g = (c >>  8) & 0xFF;
-  b = (c      ) & 0xFF;
-  setFading(pixelNum, r, g, b);
+  this->strip->setPixelColor(this->firstPixel + pixelNum, 0); // fade in from black
 }
 
 void Fader8bit::stopFading(uint8_t pixelNum)
@@ -71,9 +75,20 @@ void Fader8bit::stopFading(uint8_t pixelNum)
   uint8_t idx = pixelNum / 8;
   uint8_t bitNum = pixelNum % 8;
 
+  if (isFading(pixelNum)) {
+    this->numFading--;
+  }
   this->fadingBits[idx] &= ~(1 << bitNum);
 }
 
+void Fader8bit::stopAllFading()
+{
+  for (int i=0; i<(this->numPixels/8)+1; i++) {
+    this->fadingBits[i] = 0;
+  }
+  this->numFading = 0;
+}
+
 bool Fader8bit::isIncreasing(uint8_t pixelNum)
 {
   uint8_t idx = pixelNum / 8;
@@ -94,25 +109,34 @@ void Fader8bit::setDirection(uint8_t pixelNum, bool increasing)
   }
 }
 
+#endif
+
+void Fader8bit::setFading(uint8_t pixelNum, uint32_t c)
+{
+  uint8_t r, g, b;
+  r = (c >> 16) & 0xFF;
+  g = (c >>  8) & 0xFF;
+  b = (c      ) & 0xFF;
+  setFading(pixelNum, r, g, b);
+}
+
+// These two are asked often (every twinkle, and whenever the main loop 
+// wants to know if it can sleep), so rather than scanning fadingBits we keep 
+// a running count in setFading/stopFading.
 bool Fader8bit::areAnyFading()
 {
-  for (uint8_t idx = 0; idx < this->numPixels; idx++) {
-    if (isFading(idx)) {
-      return true;
-    }
-  }
-  return false;
+  return (this->numFading != 0);
 }
 
 int Fader8bit::countFading()
 {
-  int count = 0;
-  for (uint8_t idx = 0; idx < this->numPixels; idx++) {
-    if (isFading(idx)) {
-      count++;
-    }
-  }
-  return count;
+  return this->numFading;
+}
+
+// When performFade() will next step the fades (if there are any).
+unsigned long Fader8bit::nextFadeMillis()
+{
+  return nextMillis;
 }
 
 void Fader8bit::setFadeMode(bool fadeInOnly)
@@ -183,10 +207,13 @@ uint32_t Fader8bit::fadeStepForPixel(uint8_t pixelNum)
   return target;
 }
 
+#ifndef FADER8BIT_SOA
+// The packed-bitmap backend (cf. Fader8bitSoA.cpp)
+
 bool Fader8bit::capColorValue(uint8_t pixelNum, bool increasing, uint32_t RGBstep)
 {
   // What color is the pixel right now?
-  uint32_t c = this->strip->getPixelColor(pixelNum);
+  uint32_t c = this->strip->getPixelColor(this->firstPixel + pixelNum);
   uint8_t r = (c >> 16) & 0xFF;
   uint8_t g = (c >>  8) & 0xFF;
   uint8_t b = (c      ) & 0xFF;
@@ -253,42 +280,12 @@ bool Fader8bit::capColorValue(uint8_t pixelNum, bool increasing, uint32_t RGBste
   }
 
   // Set the pixelData to the value we want
-  this->strip->setPixelColor(pixelNum, r, g, b);
+  this->strip->setPixelColor(this->firstPixel + pixelNum, r, g, b);
 
   // Return true if we've reached our current target (in- or de-creasing)
   return (count == 3);
 }
 
-bool Fader8bit::stepOnePixel(uint8_t idx)
-{
-  uint32_t s = fadeStepForPixel(idx);
-  if (s == 0)
-    return false;
-  
-  if (!isFading(idx)) 
-    return false;
-  
-  if (isIncreasing(idx)) {
-    if (capColorValue(idx, true, s)) {
-      // If we reached the max, then change the direction                                  
-      if (this->fadeInOnly) {
-	stopFading(idx);
-	numExtinguishedLastFade++;
-      } else {
-	setDirection(idx, false);
-      }
-    }
-  } else {
-    if (capColorValue(idx, false, s)) {
-      // If we reached zero, then turn off isFading                                        
-      stopFading(idx);
-      numExtinguishedLastFade++;
-    }
-  }
-
-  return true;
-}
-
 // One step in the fade action, to be called regularly. 
 // returns true if it updates any LEDs.
 bool Fader8bit::performFade()
@@ -297,6 +294,10 @@ bool Fader8bit::performFade()
 
   bool retval = false;
 
+  if (this->numFading == 0) {
+    return false;
+  }
+
   if (millis() >= nextMillis) {
     for (uint8_t idx = 0; idx < this->numPixels; idx++) {
       if (isFading(idx)) {
@@ -334,6 +335,38 @@ bool Fader8bit::performFade()
   return retval;
 }
 
+#endif
+
+bool Fader8bit::stepOnePixel(uint8_t idx)
+{
+  uint32_t s = fadeStepForPixel(idx);
+  if (s == 0)
+    return false;
+  
+  if (!isFading(idx)) 
+    return false;
+  
+  if (isIncreasing(idx)) {
+    if (capColorValue(idx, true, s)) {
+      // If we reached the max, then change the direction                                  
+      if (this->fadeInOnly) {
+	stopFading(idx);
+	numExtinguishedLastFade++;
+      } else {
+	setDirection(idx, false);
+      }
+    }
+  } else {
+    if (capColorValue(idx, false, s)) {
+      // If we reached zero, then turn off isFading                                        
+      stopFading(idx);
+      numExtinguishedLastFade++;
+    }
+  }
+
+  return true;
+}
+
 uint8_t Fader8bit::howManyWentOut()
 {
   return numExtinguishedLastFade;
@@ -344,4 +377,3 @@ uint8_t Fader8bit::get8bitTargetColor(uint8_t pixelNum)
   return targetColor[pixelNum];
 }
 
-
@@ -1,10 +1,15 @@
 #include <Arduino.h>
 #include <Adafruit_Neopixel.h>
 
+#ifndef __FADER8BIT_H
+#define __FADER8BIT_H
+
 /*
  * This pixel-fading class is designed to use relatively little memory, at 
  * the expense of CPU time. It is bound to the size of a byte, so cannot 
- * handle more than 256 LEDs as coded (cf. numPixels).
+ * handle more than 255 LEDs as coded (cf. numPixels). A longer strip can be
+ * split between several faders, each of which looks after a window of 
+ * numPixels LEDs starting at firstPixel (cf. StripGroup).
  *
  * My ideal version of this (that can eat as much RAM as it wants) would 
  * keep track of
@@ -44,28 +49,48 @@
  * device that only has 1500 bytes of RAM, this buys us a significant chunk 
  * of RAM.
  *
+ * On a Linux-class controller the trade is the other way around: RAM is 
+ * plentiful, and the bit math, the getPixelColor() calls and the branching 
+ * per pixel are what cost us. Building with FADER8BIT_SOA swaps in the 
+ * backend in Fader8bitSoA.cpp, which keeps a separate byte array for each 
+ * of current R/G/B, target R/G/B, step R/G/B, fading and direction (12 
+ * bytes per pixel), and steps every pixel in one branch-free loop that the 
+ * compiler can vectorize. The public interface, and what ends up on the 
+ * strip, are the same either way: a dimmed strip doesn't give back exactly
+ * what was written to it, and this backend steps from what it reads back,
+ * so while the strip is dimmed (or just after its brightness changes) 
+ * the SoA one reads it back too.
+ * (GCC only vectorizes it at -O3, or at -O2 with -fvect-cost-model=dynamic;
+ * without that it's no faster than this one. host/bench_fader compares 
+ * the two.)
+ *
  */
 
 class Fader8bit {
 
  public:
-  Fader8bit(Adafruit_NeoPixel *s);
+  // numPixels == 0 means the rest of the strip (up to 255)
+  Fader8bit(Adafruit_NeoPixel *s, uint16_t firstPixel = 0, uint8_t numPixels = 0);
   ~Fader8bit();
   void reset();
+  // Call after the strip's setBrightness(), which rescales what's in it
+  void brightnessChanged();
 
   bool isFading(uint8_t pixelNum);
   void setFading(uint8_t pixelNum, uint8_t r, uint8_t g, uint8_t b);
   void setFading(uint8_t pixelNum, uint32_t c);
   void stopFading(uint8_t pixelNum);
+  void stopAllFading();
   bool isIncreasing(uint8_t pixelNum);
   void setDirection(uint8_t pixelNum, bool increasing);
   int countFading();
   bool areAnyFading();
+  unsigned long nextFadeMillis();
 
   void setFadeMode(bool fadeInOnly);
 
-  uint8_t reduceColorTo8bit(uint32_t rgb);
-  uint8_t reduceColorTo8bit(uint8_t r, uint8_t g, uint8_t b);
+  static uint8_t reduceColorTo8bit(uint32_t rgb);
+  static uint8_t reduceColorTo8bit(uint8_t r, uint8_t g, uint8_t b);
   uint32_t expandColorFrom8bit(uint8_t c);
 
   uint32_t fadeStepForPixel(uint8_t pixelNum);
@@ -81,20 +106,42 @@ class Fader8bit {
  private:
   // Private copies of pixel data pointer/size
   Adafruit_NeoPixel *strip;
+  uint16_t firstPixel;
   uint8_t numPixels;
 
+#ifndef FADER8BIT_SOA
   //   Are we fading? (yes/no) - an array of (TOTAL_LEDS/8) + 1
   uint8_t *fadingBits;
   
   //   Is the fade increasing (1) or decreasing (0)?
   uint8_t *fadeDirectionBits;
+#else
+  //   One allocation that all of the arrays below live in
+  uint8_t *soaBlock;
+
+  //   Each of these is an array of TOTAL_LEDS
+  uint8_t *curR, *curG, *curB;    // current color (the strip is a copy)
+  uint8_t *tgtR, *tgtG, *tgtB;    // expanded targetColor
+  uint8_t *stepR, *stepG, *stepB; // cf. fadeStepForPixel
+  uint8_t *fading;                // 1 if fading, 0 if not
+  uint8_t *increasing;            // 1 if increasing, 0 if decreasing
+  uint8_t *changed;               // 1 if the last performFade() touched it
+  bool rescaled;                  // cf. brightnessChanged()
+
+  void readStrip();
+#endif
   
   //   What is the target brightest value of this fade? - an array of TOTAL_LEDS
   //      (2 bits per R/G/B)
   uint8_t *targetColor;
 
+  //   How many bits are set in fadingBits?
+  uint8_t numFading;
+
   uint8_t numExtinguishedLastFade;
   bool fadeInOnly;
 
   unsigned long nextMillis;
 };
+
+#endif
@@ -0,0 +1,259 @@
+#include "Fader8bit.h"
+
+#ifdef FADER8BIT_SOA
+// The structure-of-arrays backend (cf. Fader8bit.h). The current color of
+// each fading pixel lives in curR/curG/curB, and is copied out to the strip
+// after each step. We read the strip back in reset(), which is where the 
+// modes repaint underneath fades that are still running, and before each
+// step while the strip is dimmed (cf. performFade()).
+
+// One channel of one fade step, without branches: every choice is made 
+// with a mask that's either 0x00 or 0xFF. Returns the new value, and sets 
+// reached to 0xFF if it hit the end of the fade (the target, going up; or
+// zero, going down). upMask is 0xFF going up, 0x00 going down.
+static inline uint8_t stepChannel(uint8_t c, uint8_t t, uint8_t s, 
+				  uint8_t upMask, uint8_t &reached)
+{
+  // If the pixel is already brighter than the target, that's the new target
+  uint8_t top = (c > t) ? c : t;
+
+  uint8_t upReached = -(uint8_t)((uint8_t)(top - c) <= s);
+  uint8_t downReached = -(uint8_t)(c <= s);
+  uint8_t upValue = (top & upReached) | ((uint8_t)(c + s) & ~upReached);
+  uint8_t downValue = (uint8_t)(c - s) & ~downReached;
+
+  reached = (upReached & upMask) | (downReached & ~upMask);
+  return (upValue & upMask) | (downValue & ~upMask);
+}
+
+Fader8bit::Fader8bit(Adafruit_NeoPixel *s, uint16_t firstPixel, uint8_t numPixels)
+{
+  this->strip = s;
+  this->firstPixel = firstPixel;
+  this->numPixels = numPixels ? numPixels : min(s->numPixels() - firstPixel, 255);
+  this->targetColor = (uint8_t*)malloc(this->numPixels);
+  this->fadeInOnly = false;
+
+  uint16_t n = this->numPixels;
+  this->soaBlock = (uint8_t*)malloc(n * 12);
+  this->curR = this->soaBlock;
+  this->curG = this->curR + n;
+  this->curB = this->curG + n;
+  this->tgtR = this->curB + n;
+  this->tgtG = this->tgtR + n;
+  this->tgtB = this->tgtG + n;
+  this->stepR = this->tgtB + n;
+  this->stepG = this->stepR + n;
+  this->stepB = this->stepG + n;
+  this->fading = this->stepB + n;
+  this->increasing = this->fading + n;
+  this->changed = this->increasing + n;
+  memset(this->soaBlock, 0, n * 12);
+
+  this->numFading = 0;
+  this->nextMillis = 0;
+  this->rescaled = false;
+}
+
+Fader8bit::~Fader8bit()
+{
+  free(this->soaBlock);
+  free(this->targetColor);
+}
+
+void Fader8bit::reset()
+{
+  // For anything that is still fading, make sure it's fading *out* now - 
+  // from whatever the pixel has been set to since.
+  readStrip();
+  for (int i=0; i<this->numPixels; i++) {
+    if (this->fading[i]) {
+      this->increasing[i] = 0;
+    }
+  }
+}
+
+// Pick up the current color of every fading pixel from the strip
+void Fader8bit::readStrip()
+{
+  for (int i=0; i<this->numPixels; i++) {
+    if (this->fading[i]) {
+      uint32_t c = this->strip->getPixelColor(this->firstPixel + i);
+      this->curR[i] = (c >> 16) & 0xFF;
+      this->curG[i] = (c >>  8) & 0xFF;
+      this->curB[i] = (c      ) & 0xFF;
+    }
+  }
+  this->rescaled = false;
+}
+
+void Fader8bit::brightnessChanged()
+{
+  this->rescaled = true;
+}
+
+bool Fader8bit::isFading(uint8_t pixelNum)
+{
+  return this->fading[pixelNum];
+}
+
+void Fader8bit::setFading(uint8_t pixelNum, 
+			  uint8_t r, uint8_t g, uint8_t b)
+{
+  if (!this->fading[pixelNum]) {
+    this->numFading++;
+  }
+  this->fading[pixelNum] = 1;     // Yes, we are fading;
+  this->increasing[pixelNum] = 1; // and we are increasing.
+
+  this->targetColor[pixelNum] = reduceColorTo8bit(r, g, b); // calc target color
+
+  uint32_t target = expandColorFrom8bit(this->targetColor[pixelNum]);
+  this->tgtR[pixelNum] = (target >> 16) & 0xFF;
+  this->tgtG[pixelNum] = (target >>  8) & 0xFF;
+  this->tgtB[pixelNum] = (target      ) & 0xFF;
+
+  uint32_t step = fadeStepForPixel(pixelNum);
+  this->stepR[pixelNum] = (step >> 16) & 0xFF;
+  this->stepG[pixelNum] = (step >>  8) & 0xFF;
+  this->stepB[pixelNum] = (step      ) & 0xFF;
+
+  // fade in from black
+  this->curR[pixelNum] = this->curG[pixelNum] = this->curB[pixelNum] = 0;
+  this->strip->setPixelColor(this->firstPixel + pixelNum, 0);
+}
+
+void Fader8bit::stopFading(uint8_t pixelNum)
+{
+  if (this->fading[pixelNum]) {
+    this->numFading--;
+  }
+  this->fading[pixelNum] = 0;
+}
+
+void Fader8bit::stopAllFading()
+{
+  memset(this->fading, 0, this->numPixels);
+  this->numFading = 0;
+}
+
+bool Fader8bit::isIncreasing(uint8_t pixelNum)
+{
+  return this->increasing[pixelNum];
+}
+
+void Fader8bit::setDirection(uint8_t pixelNum, bool increasing)
+{
+  this->increasing[pixelNum] = increasing ? 1 : 0;
+}
+
+bool Fader8bit::capColorValue(uint8_t pixelNum, bool increasing, uint32_t RGBstep)
+{
+  uint8_t up = increasing ? 0xFF : 0;
+  uint8_t reachedR, reachedG, reachedB;
+
+  // One pixel at a time isn't the fast path, so step from whatever the 
+  // strip has, as the packed backend does
+  uint32_t c = this->strip->getPixelColor(this->firstPixel + pixelNum);
+  this->curR[pixelNum] = (c >> 16) & 0xFF;
+  this->curG[pixelNum] = (c >>  8) & 0xFF;
+  this->curB[pixelNum] = (c      ) & 0xFF;
+
+  this->curR[pixelNum] = stepChannel(this->curR[pixelNum], this->tgtR[pixelNum],
+				     (RGBstep >> 16) & 0xFF, up, reachedR);
+  this->curG[pixelNum] = stepChannel(this->curG[pixelNum], this->tgtG[pixelNum],
+				     (RGBstep >>  8) & 0xFF, up, reachedG);
+  this->curB[pixelNum] = stepChannel(this->curB[pixelNum], this->tgtB[pixelNum],
+				     (RGBstep      ) & 0xFF, up, reachedB);
+
+  this->strip->setPixelColor(this->firstPixel + pixelNum, this->curR[pixelNum], 
+			     this->curG[pixelNum], this->curB[pixelNum]);
+
+  // Return true if we've reached our current target (in- or de-creasing)
+  return (reachedR && reachedG && reachedB);
+}
+
+// The fade step for every pixel at once. Steps every pixel, whether or not
+// it's fading, and throws away the result for the ones that aren't; with no
+// branches and no overlapping arrays, the compiler can vectorize the loop.
+// Returns how many fades finished.
+static uint8_t fadeKernel(uint16_t n, uint8_t stopAtTop,
+			  uint8_t * __restrict__ cR,
+			  uint8_t * __restrict__ cG,
+			  uint8_t * __restrict__ cB,
+			  const uint8_t * __restrict__ tR,
+			  const uint8_t * __restrict__ tG,
+			  const uint8_t * __restrict__ tB,
+			  const uint8_t * __restrict__ sR,
+			  const uint8_t * __restrict__ sG,
+			  const uint8_t * __restrict__ sB,
+			  uint8_t * __restrict__ fad,
+			  uint8_t * __restrict__ inc,
+			  uint8_t * __restrict__ chg)
+{
+  uint8_t extinguished = 0;
+
+  for (uint16_t i=0; i<n; i++) {
+    uint8_t active = fad[i];
+    uint8_t up = inc[i];
+    uint8_t activeMask = -active;
+    uint8_t reachedR, reachedG, reachedB;
+
+    uint8_t r = stepChannel(cR[i], tR[i], sR[i], -up, reachedR);
+    uint8_t g = stepChannel(cG[i], tG[i], sG[i], -up, reachedG);
+    uint8_t b = stepChannel(cB[i], tB[i], sB[i], -up, reachedB);
+    cR[i] = (r & activeMask) | (cR[i] & ~activeMask);
+    cG[i] = (g & activeMask) | (cG[i] & ~activeMask);
+    cB[i] = (b & activeMask) | (cB[i] & ~activeMask);
+
+    // When a fade reaches its end: going up, it turns around (or stops, if 
+    // we only fade in); going down, it stops.
+    uint8_t done = active & reachedR & reachedG & reachedB & 1;
+    uint8_t stop = done & ((up ^ 1) | stopAtTop);
+    inc[i] = up & ((done & (stopAtTop ^ 1)) ^ 1);
+    fad[i] = active & (stop ^ 1);
+    chg[i] = active;
+    extinguished += stop;
+  }
+  return extinguished;
+}
+
+// One step in the fade action, to be called regularly. 
+// returns true if it updates any LEDs.
+bool Fader8bit::performFade()
+{
+  numExtinguishedLastFade = 0;
+
+  if (this->numFading == 0 || millis() < nextMillis) {
+    return false;
+  }
+
+  // A dimmed strip gives back less than was written to it (and 
+  // setBrightness() rescales what's there). The packed backend steps from
+  // what it reads back, and we show the same frames it does; at full 
+  // brightness, and with no rescale since, that's just what we wrote.
+  if (this->rescaled || this->strip->getBrightness() != 255) {
+    readStrip();
+  }
+
+  uint8_t extinguished = fadeKernel(this->numPixels, this->fadeInOnly ? 1 : 0,
+				    this->curR, this->curG, this->curB,
+				    this->tgtR, this->tgtG, this->tgtB,
+				    this->stepR, this->stepG, this->stepB,
+				    this->fading, this->increasing, this->changed);
+
+  // Then copy what changed out to the strip
+  for (uint16_t i=0; i<this->numPixels; i++) {
+    if (this->changed[i]) {
+      this->strip->setPixelColor(this->firstPixel + i, 
+				 this->curR[i], this->curG[i], this->curB[i]);
+    }
+  }
+
+  this->numFading -= extinguished;
+  numExtinguishedLastFade = extinguished;
+  nextMillis = millis() + 10;
+  return true;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "FrameTrace.h"
+
+FrameTrace::FrameTrace(Print *out, pixelnum_t numPixels)
+{
+  this->out = out;
+  this->numPixels = numPixels;
+  this->lastFrame = (uint8_t*)malloc(numPixels * 3);
+  if (!this->lastFrame) {
+    // Not enough RAM: no trace, and record() does nothing
+    this->numPixels = 0;
+    return;
+  }
+  memset(this->lastFrame, 0, numPixels * 3);
+
+  this->out->write('B');
+  this->out->write('F');
+  this->out->write('T');
+  this->out->write(FRAMETRACE_VERSION);
+  write32(numPixels);
+}
+
+FrameTrace::~FrameTrace()
+{
+  free(this->lastFrame);
+}
+
+void FrameTrace::write16(uint16_t v)
+{
+  this->out->write(v & 0xFF);
+  this->out->write(v >> 8);
+}
+
+void FrameTrace::write32(uint32_t v)
+{
+  write16(v & 0xFFFF);
+  write16(v >> 16);
+}
+
+bool FrameTrace::isOpen()
+{
+  return (this->lastFrame != NULL);
+}
+
+// Called right after each frame is shown.
+void FrameTrace::record(StripGroup *strips)
+{
+  if (!this->lastFrame) {
+    return;
+  }
+
+  uint32_t now = millis();
+
+  // Compare the strips' buffers with lastFrame and bring it up to date. 
+  // In the first strip that differs we scan forward to the first changed 
+  // byte; in every strip that does, back from the end to the last one. 
+  // Only the span between is copied.
+  uint32_t total = (uint32_t)this->numPixels * 3;
+  uint32_t first = total;  // bytes, from the start of the frame
+  uint32_t end = 0;        // one past the last changed byte
+  uint32_t offset = 0;
+  for (uint8_t s=0; s<strips->numStrips() && offset < total; s++) {
+    uint16_t n;
+    const uint8_t *pixels = strips->getPixels(s, &n);
+    uint32_t len = min((uint32_t)n * 3, total - offset);
+    uint8_t *prev = &this->lastFrame[offset];
+
+    uint32_t i = 0;
+    if (first == total) {
+      while (i < len && pixels[i] == prev[i]) {
+	i++;
+      }
+      if (i < len) {
+	first = offset + i;
+      }
+    }
+    if (i < len) {
+      uint32_t j = len;
+      while (j > i && pixels[j-1] == prev[j-1]) {
+	j--;
+      }
+      if (j > i) {
+	memcpy(&prev[i], &pixels[i], j - i);
+	end = offset + j;
+      }
+    }
+    offset += len;
+  }
+
+  uint32_t firstPixel = 0, count = 0;
+  if (first < total) {
+    firstPixel = first / 3;
+    count = (end - 1) / 3 - firstPixel + 1;
+  }
+
+  write32(now);
+  write32(firstPixel);
+  write32(count);
+  if (count) {
+    this->out->write(&this->lastFrame[firstPixel*3], count*3);
+  }
+}
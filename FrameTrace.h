@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include "StripGroup.h"
+
+#ifndef __FRAMETRACE_H
+#define __FRAMETRACE_H
+
+/*
+ * Records every frame that's presented to the strips, as a compact binary
+ * stream, so that a misbehaving mode can be picked apart afterwards instead
+ * of only being watched on the LEDs.
+ *
+ * The output goes to any Print: a second UART, a file on an SD card or 
+ * flash, or a file-backed Print on a host build. The stream starts with a
+ * header:
+ *
+ *   'B' 'F' 'T' <version=2> <numPixels: uint32>
+ *
+ * and then has one record per presented frame:
+ *
+ *   <millis: uint32> <first: uint32> <count: uint32> <count * G,R,B bytes>
+ *
+ * (all multibyte values are little-endian). The pixel bytes are exactly 
+ * what was in the strips' buffers when they were shown - the library's 
+ * G,R,B order, with the brightness already applied - so nothing is lost 
+ * to reading colors back through the brightness scaling. Pixels are 
+ * numbered across all of the strips, as in StripGroup.
+ *
+ * Each record only carries the run of pixels from the first to the last 
+ * one that changed since the previous record; the frame before the first
+ * record is all black. A count of 0 means the frame was presented without
+ * any pixel changes.
+ *
+ * To find those changes we keep a copy of the previous frame: 3 bytes per 
+ * pixel, allocated only when a trace is created. (That's 450 bytes for 150
+ * pixels; on an AVR it may well not fit, in which case isOpen() is false,
+ * nothing is written and record() does nothing.)
+ *
+ * Don't trace to the Serial port that commands come in on. A full frame is
+ * 3 bytes a pixel, and writing it blocks the loop for as long as it takes 
+ * to go out at the line rate (40ms for 150 pixels at 115200), while the 
+ * commands go unread; and the pixel bytes are bound to include 0x06, 
+ * which a host streaming commands takes as ACK (see SerialInput.h).
+ * host/tracetool reads traces back on a host.
+ */
+
+#define FRAMETRACE_VERSION 2
+
+class FrameTrace {
+ public:
+  FrameTrace(Print *out, pixelnum_t numPixels);
+  ~FrameTrace();
+
+  bool isOpen();
+  void record(StripGroup *strips);
+
+ private:
+  void write16(uint16_t v);
+  void write32(uint32_t v);
+
+ private:
+  Print *out;
+  pixelnum_t numPixels;
+  uint8_t *lastFrame;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "ProceduralEffects.h"
+
+// One quarter of a sine wave, amplitude 127, over 64 steps (plus the peak)
+static const uint8_t quarterSine[65] PROGMEM = {
+    0,   3,   6,   9,  12,  16,  19,  22,  25,  28,  31,  34,  37,
+   40,  43,  46,  49,  51,  54,  57,  60,  63,  65,  68,  71,  73,
+   76,  78,  81,  83,  85,  88,  90,  92,  94,  96,  98, 100, 102,
+  104, 106, 107, 109, 111, 112, 113, 115, 116, 117, 118, 120, 121,
+  122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127, 127
+};
+
+uint8_t sin8(uint8_t theta)
+{
+  uint8_t idx = theta & 0x3F;
+
+  // Odd quadrants run the table backwards...
+  uint8_t s = pgm_read_byte(&quarterSine[(theta & 0x40) ? 64 - idx : idx]);
+
+  // ... and the second half of the cycle is the negative of the first.
+  return (theta & 0x80) ? 128 - s : 128 + s;
+}
@@ -0,0 +1,204 @@
+#include <Arduino.h>
+#include "StripGroup.h"
+
+#ifndef __PROCEDURALEFFECTS_H
+#define __PROCEDURALEFFECTS_H
+
+/*
+ * Stateless effect kernels. Each one computes a pixel's color directly from
+ * its index, the current time phase and the mode parameters, so they need
+ * no per-pixel state at all (unlike the fader-driven modes, whose RAM grows
+ * with the strip length). The only data is a quarter-wave sine table that
+ * lives in flash.
+ *
+ * Colors are in the same xxRRGGBB form as Adafruit_NeoPixel::Color().
+ */
+
+// 0..255 in, 1..255 out: one full sine cycle centered on 128
+uint8_t sin8(uint8_t theta);
+
+// Blend from c1 (amount 0) to c2 (amount 255). Each channel is weighted 
+// in unsigned 16-bit math: a*(256-amount) + b*amount is at most 255*256, 
+// so it can't overflow even where int is 16 bits.
+inline uint32_t blendColor(uint32_t c1, uint32_t c2, uint8_t amount)
+{
+  uint32_t retval = 0;
+  uint16_t keep = 256 - amount;
+  for (uint8_t shift = 0; shift <= 16; shift += 8) {
+    uint16_t a = (c1 >> shift) & 0xFF;
+    uint16_t b = (c2 >> shift) & 0xFF;
+    retval |= (uint32_t)((uint16_t)(a * keep + b * amount) >> 8) << shift;
+  }
+  return retval;
+}
+
+// Hue wheel built from three sine waves 120 degrees apart
+inline uint32_t hueToColor(uint8_t hue)
+{
+  return ((uint32_t)sin8(hue) << 16) | 
+    ((uint32_t)sin8(hue + 85) << 8) | 
+    sin8(hue + 170);
+}
+
+/*
+ * Each effect is a struct with the opcode that selects it (the same byte 
+ * as the mode command, where there is one) and a static render() that 
+ * computes one pixel. The EffectRegistry below looks one up by opcode, 
+ * once per layer or mode, and hands back a kernel that draws it over a 
+ * run of pixels with the effect and blendop compiled in: no virtual call,
+ * and no opcode to test, per pixel.
+ */
+
+struct _EffectParams {
+  uint8_t phase;   // time, as from SimpleStripLights::proceduralPhase()
+  uint32_t color;
+  uint32_t color2;
+};
+
+// A single color
+struct SolidEffect {
+  enum { opcode = 'C' };
+  static inline uint32_t render(pixelnum_t, const struct _EffectParams &p)
+  {
+    return p.color;
+  }
+};
+
+// A rainbow spread along the strip, scrolling with time
+struct RainbowEffect {
+  enum { opcode = 'h' };
+  static inline uint32_t render(pixelnum_t pixelNum, const struct _EffectParams &p)
+  {
+    return hueToColor((pixelNum << 2) + p.phase);
+  }
+};
+
+// A sine wave of brightness between color2 (troughs) and color (peaks)
+struct SineEffect {
+  enum { opcode = 's' };
+  static inline uint32_t render(pixelnum_t pixelNum, const struct _EffectParams &p)
+  {
+    return blendColor(p.color2, p.color, sin8((pixelNum << 3) - p.phase));
+  }
+};
+
+// Two sine waves of different lengths moving in opposite directions; 
+// their sum blends between color2 and color
+struct PlasmaEffect {
+  enum { opcode = 'P' };
+  static inline uint32_t render(pixelnum_t pixelNum, const struct _EffectParams &p)
+  {
+    uint16_t v = sin8((pixelNum * 11) + p.phase) + 
+      sin8((pixelNum * 5) - (p.phase << 1));
+    return blendColor(p.color2, p.color, v >> 1);
+  }
+};
+
+// The whole strip breathes in and out of color together, like tardis mode
+// (but with no faders)
+struct BreatheEffect {
+  enum { opcode = 't' };
+  static inline uint32_t render(pixelnum_t, const struct _EffectParams &p)
+  {
+    return blendColor(0, p.color, sin8(p.phase));
+  }
+};
+
+// Scattered pixels flash up in color or color2 and back out, like twinkle 
+// mode (but with no faders): each pixel's own speed, offset and color come
+// from a hash of its number (all of it, so that a long strip doesn't 
+// repeat itself every few thousand pixels).
+struct SparkleEffect {
+  enum { opcode = 'T' };
+  static inline uint32_t render(pixelnum_t pixelNum, const struct _EffectParams &p)
+  {
+    pixelnum_t high = pixelNum >> 11;
+    uint8_t hash = (pixelNum * 167) ^ (pixelNum >> 3) ^ high ^ (high >> 8) ^ 0x5A;
+    uint8_t level = sin8(p.phase * ((hash & 3) + 1) + hash);
+    // Only the top of each wave lights up, so most pixels are dark
+    level = (level > 192) ? (level - 192) << 2 : 0;
+    return blendColor(0, (hash & 0x80) ? p.color : p.color2, level);
+  }
+};
+
+// How a layer is combined with what's underneath it
+enum blendop {
+  BlendReplace = 0,
+  BlendAdd,         // add, saturating at 255 per channel
+  BlendMax          // the brighter of the two, per channel
+};
+
+inline uint32_t blendLayer(uint32_t under, uint32_t over, uint8_t op)
+{
+  if (op == BlendReplace) {
+    return over;
+  }
+
+  uint32_t retval = 0;
+  for (uint8_t shift = 0; shift <= 16; shift += 8) {
+    uint8_t a = (under >> shift) & 0xFF;
+    uint8_t b = (over >> shift) & 0xFF;
+    uint8_t c;
+    if (op == BlendAdd) {
+      c = (a + b > 255) ? 255 : a + b;
+    } else {
+      c = (a > b) ? a : b;
+    }
+    retval |= (uint32_t)c << shift;
+  }
+  return retval;
+}
+
+/*
+ * A kernel draws one effect over count pixels starting at first, combining
+ * it with the colors already in colors[] by one blendop. Kernels work on
+ * EFFECT_TILE pixels at a time, so that several layers can be drawn over
+ * a tile while it's still in registers and cache.
+ */
+#define EFFECT_TILE 16
+
+typedef void (*EffectKernel)(const struct _EffectParams &p, pixelnum_t first,
+			     uint8_t count, uint32_t *colors);
+
+template <class Effect, uint8_t op>
+void renderRange(const struct _EffectParams &p, pixelnum_t first, 
+		 uint8_t count, uint32_t *colors)
+{
+  for (uint8_t k=0; k<count; k++) {
+    colors[k] = blendLayer(colors[k], Effect::render(first + k, p), op);
+  }
+}
+
+template <class... Effects> struct EffectRegistry;
+
+template <> struct EffectRegistry<> {
+  static inline EffectKernel kernel(uint8_t, uint8_t)
+  {
+    return NULL;
+  }
+};
+
+template <class First, class... Rest> struct EffectRegistry<First, Rest...> {
+  // NULL if there's no such effect or blendop
+  static inline EffectKernel kernel(uint8_t opcode, uint8_t blend)
+  {
+    if (opcode != First::opcode) {
+      return EffectRegistry<Rest...>::kernel(opcode, blend);
+    }
+    switch (blend) {
+    case BlendReplace:
+      return renderRange<First, BlendReplace>;
+    case BlendAdd:
+      return renderRange<First, BlendAdd>;
+    case BlendMax:
+      return renderRange<First, BlendMax>;
+    }
+    return NULL;
+  }
+};
+
+// Adding an effect is just a matter of adding it here.
+typedef EffectRegistry<SolidEffect, RainbowEffect, SineEffect, PlasmaEffect,
+		       BreatheEffect, SparkleEffect> Effects;
+
+#endif
@@ -0,0 +1,105 @@
+#include "SerialInput.h"
+
+SerialInput::SerialInput(Stream *port, SimpleStripLights *lights)
+{
+  this->port = port;
+  this->lights = lights;
+  this->state = Idle;
+  this->credit = 0;
+  this->remaining = 0;
+  this->wantGrant = false;
+  this->deadline = 0;
+}
+
+// Are granted bytes still on their way? If so, the lights mustn't show()
+// until they're here.
+bool SerialInput::isReceiving()
+{
+  if (this->state == AwaitingReply) {
+    return true;
+  }
+  // Once they're all in the UART's buffer, they're safe
+  return (this->state == Receiving && 
+	  this->remaining > this->port->available());
+}
+
+void SerialInput::poll()
+{
+  if (isReceiving() && millis() >= this->deadline) {
+    // The host has gone quiet on us
+    this->state = Idle;
+    this->credit = 0;
+    this->remaining = 0;
+  }
+  // A new grant waits for this pass, so that update() has run (and shown
+  // what came in with the last one) in between
+  if (this->state == Idle && this->wantGrant) {
+    grant();
+  }
+
+  // Take everything that's waiting, as far as the lights have room; the 
+  // rest stays in the UART's buffer for the next pass.
+  byte data[SERIAL_RX_BUFFER_SIZE];
+  int len = 0;
+  int space = this->lights->inputSpaceAvailable();
+  while (len < SERIAL_RX_BUFFER_SIZE && this->port->available() > 0) {
+    if (this->state != AwaitingReply && len >= space) {
+      break;
+    }
+    byte b = this->port->read();
+
+    switch (this->state) {
+    case Idle:
+      if (b == ENQ) {
+	this->wantGrant = true;
+      } else {
+	data[len++] = b;
+      }
+      break;
+    case AwaitingReply:
+      if ((b & 0x80) && (b & 0x7F) <= this->credit) {
+	this->remaining = b & 0x7F;
+	this->credit = 0;
+	this->state = this->remaining ? Receiving : Idle;
+      } else if (b != ENQ) {
+	// Not a reply, so not a host that knows about credit
+	this->credit = 0;
+	this->state = Idle;
+	data[len++] = b;
+      }
+      break;
+    case Receiving:
+      data[len++] = b;
+      if (--this->remaining == 0) {
+	this->state = Idle;
+	this->wantGrant = true;
+      }
+      break;
+    }
+  }
+  if (len) {
+    this->lights->handleCommands(data, len);
+  }
+}
+
+void SerialInput::grant()
+{
+  // As much as we can take in without update() running: what the lights
+  // can buffer, plus what the UART can hold (less the reply's length 
+  // byte, and whatever is already in it).
+  int n = this->lights->inputSpaceAvailable() + 
+    SERIAL_RX_BUFFER_SIZE - 1 - this->port->available();
+  if (n > 0x7F) {
+    n = 0x7F;
+  }
+  if (n <= 0) {
+    return; // next time, once update() has made room
+  }
+
+  this->port->write(ACK);
+  this->port->write((uint8_t)n);
+  this->credit = n;
+  this->wantGrant = false;
+  this->state = AwaitingReply;
+  this->deadline = millis() + SERIAL_CREDIT_TIMEOUT;
+}
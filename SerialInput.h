@@ -0,0 +1,71 @@
+#include <Arduino.h>
+#include "SimpleStripLights.h"
+
+#ifndef __SERIALINPUT_H
+#define __SERIALINPUT_H
+
+/*
+ * Feeds commands from a serial port to the lights, once per loop(), with
+ * credit-based flow control for hosts that stream.
+ *
+ * What overflows is the UART's receive buffer (SERIAL_RX_BUFFER_SIZE, 64 
+ * bytes on an AVR). Worse, on an AVR Adafruit_NeoPixel::show() runs with
+ * interrupts off - 4.5ms for 150 LEDs, during which 52 bytes arrive at 
+ * 115200 baud - and anything past the UART's own two-byte FIFO is lost. 
+ * No amount of reading faster helps with that, and XOFF comes too late: 
+ * the only safe time for bytes to arrive is when no show() is going on. 
+ * So the lights hand out credit, and don't show anything while credited 
+ * bytes are still on their way:
+ *
+ *   host:   ENQ (0x05)             "I have something to send"
+ *   lights: ACK (0x06) <n>         "send me up to n bytes, now"
+ *   host:   <0x80 | L> <L bytes>   (L <= n; L == 0 if it has nothing)
+ *
+ * The lights only grant as much as they can take in without running 
+ * update() - what fits in their input buffer and the UART's - and 
+ * isReceiving() is true from the grant until the last of those bytes has
+ * arrived, or until SERIAL_CREDIT_TIMEOUT if the host never answers. The
+ * sketch holds update() (and so show()) meanwhile. After a reply with 
+ * L > 0 the lights grant again as soon as they've handled it; after 
+ * L == 0 they wait for the next ENQ. An ENQ sent during a show() can be
+ * lost, so a host that hears no ACK should send ENQ again.
+ *
+ * Anything but ENQ that arrives outside a grant (someone typing 
+ * commands, or a host that doesn't know about credit) goes to the lights
+ * as it always did, without flow control.
+ */
+
+#define ENQ 0x05
+#define ACK 0x06
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+
+// How long to hold the lights waiting for a host that doesn't answer
+#ifndef SERIAL_CREDIT_TIMEOUT
+#define SERIAL_CREDIT_TIMEOUT 100
+#endif
+
+class SerialInput {
+ public:
+  SerialInput(Stream *port, SimpleStripLights *lights);
+
+  void poll();
+  bool isReceiving();
+
+ private:
+  void grant();
+
+ private:
+  Stream *port;
+  SimpleStripLights *lights;
+
+  enum { Idle, AwaitingReply, Receiving } state;
+  uint8_t credit;          // granted, and not yet replied to
+  uint8_t remaining;       // bytes of the reply still to read
+  bool wantGrant;          // the host has asked (or is likely to ask)
+  unsigned long deadline;  // millis() to give up on the host by
+};
+
+#endif
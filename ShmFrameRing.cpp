@@ -0,0 +1,166 @@
+#include "ShmFrameRing.h"
+
+#ifdef __unix__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ShmFrameRing::ShmFrameRing(const char *name, uint32_t frameBytes, uint32_t numSlots)
+{
+  this->name = strdup(name);
+  this->isWriter = false; // until the ring is ours
+  this->header = NULL;
+  this->nextFrame = 1;
+
+  // Keep every slot 8-byte aligned, for the atomic sequence numbers
+  this->slotBytes = (sizeof(struct _ShmFrameSlot) + frameBytes + 7) & ~7;
+
+  if (numSlots == 0) {
+    return;
+  }
+
+  // Start from a new object rather than truncating an old one: a reader 
+  // that still has the old ring mapped would fault on the pages that 
+  // truncating takes away. Unlinked, the old ring lives on until its 
+  // readers let go, and O_EXCL makes sure nobody slips another in between.
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd == -1) {
+    return;
+  }
+  this->isWriter = true;
+  size_t size = sizeof(struct _ShmFrameRingHeader) + 
+    (size_t)this->slotBytes * numSlots;
+  if (ftruncate(fd, size) == 0 && map(fd, size, true)) {
+    // ftruncate gave us all zeroes, so every slot is already "empty"
+    this->header->magic = SHMFRAMERING_MAGIC;
+    this->header->version = SHMFRAMERING_VERSION;
+    this->header->numSlots = numSlots;
+    this->header->frameBytes = frameBytes;
+  }
+  close(fd);
+}
+
+ShmFrameRing::ShmFrameRing(const char *name)
+{
+  this->name = strdup(name);
+  this->isWriter = false;
+  this->header = NULL;
+  this->nextFrame = 0;
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && 
+      (size_t)st.st_size >= sizeof(struct _ShmFrameRingHeader) &&
+      map(fd, st.st_size, false)) {
+    // The header says how big the ring is; there has to be that much of 
+    // it, or we'd fault reading the slots at the end
+    uint64_t slotBytes = (sizeof(struct _ShmFrameSlot) + 
+			  (uint64_t)this->header->frameBytes + 7) & ~7ULL;
+    this->slotBytes = slotBytes;
+    if (this->header->magic != SHMFRAMERING_MAGIC ||
+	this->header->version != SHMFRAMERING_VERSION ||
+	this->header->numSlots == 0 ||
+	slotBytes != this->slotBytes ||
+	(uint64_t)st.st_size < sizeof(struct _ShmFrameRingHeader) + 
+	(uint64_t)this->header->numSlots * slotBytes) {
+      munmap(this->header, this->mappedSize);
+      this->header = NULL;
+    }
+  }
+  close(fd);
+}
+
+ShmFrameRing::~ShmFrameRing()
+{
+  if (this->header) {
+    munmap(this->header, this->mappedSize);
+  }
+  if (this->isWriter) {
+    // Readers that still have it mapped keep working
+    shm_unlink(this->name);
+  }
+  free(this->name);
+}
+
+bool ShmFrameRing::map(int fd, size_t size, bool writable)
+{
+  void *p = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+		 MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  this->header = (struct _ShmFrameRingHeader *)p;
+  this->mappedSize = size;
+  return true;
+}
+
+bool ShmFrameRing::isOpen()
+{
+  return (this->header != NULL);
+}
+
+uint32_t ShmFrameRing::frameBytes()
+{
+  return this->header->frameBytes;
+}
+
+struct _ShmFrameSlot *ShmFrameRing::slotFor(uint64_t frameNum)
+{
+  uint8_t *slots = (uint8_t *)(this->header + 1);
+  return (struct _ShmFrameSlot *)
+    (slots + (frameNum % this->header->numSlots) * this->slotBytes);
+}
+
+uint8_t *ShmFrameRing::beginFrame()
+{
+  struct _ShmFrameSlot *slot = slotFor(this->nextFrame);
+
+  // Odd: the slot is being written. Readers that get here first will see
+  // the change when they check isValid().
+  __atomic_store_n(&slot->sequence, this->nextFrame * 2 - 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->millis = millis();
+  return slot->data;
+}
+
+void ShmFrameRing::endFrame()
+{
+  struct _ShmFrameSlot *slot = slotFor(this->nextFrame);
+
+  __atomic_store_n(&slot->sequence, this->nextFrame * 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&this->header->latestFrame, this->nextFrame, __ATOMIC_RELEASE);
+  this->nextFrame++;
+}
+
+uint64_t ShmFrameRing::latestFrame()
+{
+  return __atomic_load_n(&this->header->latestFrame, __ATOMIC_ACQUIRE);
+}
+
+// The data for the given frame, or NULL if that frame isn't in the ring
+// (it hasn't been written yet, or it's already been overwritten).
+const uint8_t *ShmFrameRing::frameData(uint64_t frameNum)
+{
+  if (frameNum == 0 || !isValid(frameNum)) {
+    return NULL;
+  }
+  return slotFor(frameNum)->data;
+}
+
+// Is the given frame still intact in its slot? Check this after reading a
+// frame's data, to be sure the writer didn't start over it meanwhile.
+bool ShmFrameRing::isValid(uint64_t frameNum)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  struct _ShmFrameSlot *slot = slotFor(frameNum);
+  return (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == frameNum * 2);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <Arduino.h>
+
+#ifndef __SHMFRAMERING_H
+#define __SHMFRAMERING_H
+
+#ifdef __unix__
+
+/*
+ * An output for host builds: instead of sending frames to the LEDs, publish 
+ * them into a ring of frame slots in POSIX shared memory, where a preview 
+ * window or a test can look at them in place (no copying through a pipe or 
+ * a fake serial port).
+ *
+ * The writer never waits for readers. Each slot has a sequence number that 
+ * works as a seqlock: it's odd while the writer is filling the slot and 
+ * even (2 * frame number) once the frame is complete. A reader looks at a
+ * frame directly in the mapping and then checks isValid() to make sure the
+ * writer hasn't lapped it in the meantime; a reader that's too slow simply
+ * misses frames, which it can tell from gaps in the frame numbers.
+ *
+ * The shared memory holds a header, then numSlots slots, each of which is 
+ * a 16-byte slot header (sequence number and millis(), both uint64_t) 
+ * followed by frameBytes of pixel data. StripGroup publishes each strip's
+ * raw pixel buffer in turn (G,R,B per pixel, with brightness applied: 
+ * exactly what show() would have sent).
+ *
+ * Creating a ring replaces any old one of the same name. Readers that 
+ * still have the old one open keep it (and can tell it's stale, as its 
+ * frames stop coming); they have to open the name again to follow the 
+ * new writer. A reader only opens a ring that's as big as its header 
+ * says, and a writer needs at least one slot.
+ */
+
+#define SHMFRAMERING_MAGIC 0x4B4E4C42 // "BLNK"
+#define SHMFRAMERING_VERSION 1
+
+struct _ShmFrameRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t numSlots;
+  uint32_t frameBytes;
+  uint64_t latestFrame; // number of the newest complete frame (0 = none yet)
+};
+
+struct _ShmFrameSlot {
+  uint64_t sequence;
+  uint64_t millis;
+  uint8_t data[];
+};
+
+class ShmFrameRing {
+ public:
+  // Create the ring (as the writer)...
+  ShmFrameRing(const char *name, uint32_t frameBytes, uint32_t numSlots);
+  // ... or open an existing one (as a reader)
+  ShmFrameRing(const char *name);
+  ~ShmFrameRing();
+
+  bool isOpen();
+  uint32_t frameBytes();
+
+  // Writer: fill in the buffer that beginFrame() returns, then endFrame()
+  uint8_t *beginFrame();
+  void endFrame();
+
+  // Reader: find a frame (the newest one, or a particular one) and get a
+  // pointer to its data, then make sure it wasn't overwritten while in use
+  uint64_t latestFrame();
+  const uint8_t *frameData(uint64_t frameNum);
+  bool isValid(uint64_t frameNum);
+
+ private:
+  bool map(int fd, size_t size, bool writable);
+  struct _ShmFrameSlot *slotFor(uint64_t frameNum);
+
+ private:
+  char *name;
+  bool isWriter;
+  size_t mappedSize;
+  uint32_t slotBytes;
+  struct _ShmFrameRingHeader *header;
+  uint64_t nextFrame;
+};
+
+#endif
+
+#endif
@@ -4,27 +4,46 @@
 // minimum size here is 61 (size of largest packet we can recv)
 #define BUFFERSIZE 61
 
-SimpleStripLights::SimpleStripLights(uint8_t pin, int numLights, runmode defaultMode, uint32_t defaultColor, uint32_t defaultColor2) : numLights(numLights)
+SimpleStripLights::SimpleStripLights(uint8_t pin, int numLights, runmode defaultMode, uint32_t defaultColor, uint32_t defaultColor2)
 {
-  strip = new Adafruit_NeoPixel(numLights, pin, 
-				NEO_GRB | NEO_KHZ800);
-  strip->begin();
-  strip->show();
+  strips = new StripGroup();
+  // A strip that Adafruit_NeoPixel can't address is left out altogether
+  // (and the lights are dark) rather than silently cut short.
+  if (numLights > 0 && (uint16_t)numLights == numLights) {
+    strips->addStrip(pin, numLights);
+  }
+  this->numLights = strips->numPixels();
+
+  init(defaultMode, defaultColor, defaultColor2);
+}
 
-  fader = new Fader8bit(strip);
+SimpleStripLights::SimpleStripLights(StripGroup *group, runmode defaultMode, uint32_t defaultColor, uint32_t defaultColor2)
+{
+  strips = group;
+  numLights = strips->numPixels();
+
+  init(defaultMode, defaultColor, defaultColor2);
+}
 
+void SimpleStripLights::init(runmode defaultMode, uint32_t defaultColor, uint32_t defaultColor2)
+{
   bufferedInput = new RingBuffer(BUFFERSIZE);
+  trace = NULL;
+  numLayers = 0;
+  baseFrame = NULL;
+  nextLayerMillis = 0;
+  coalescing = true;
 
   currentCommandSize = 0;
 
   // Set some mode defaults: infinite repeat, default color, fading, mode
   modeData.repeat = -1;
-  modeData.color = strip->Color((defaultColor & 0xFF0000) >> 16, // R
-				(defaultColor & 0x00FF00) >>  8, // G
-				(defaultColor & 0x0000FF) );     // B
-  modeData.color2 = strip->Color((defaultColor2 & 0xFF0000) >> 16,
-				 (defaultColor2 & 0x00FF00) >> 8,
-				 (defaultColor2 & 0x0000FF) );
+  modeData.color = strips->Color((defaultColor & 0xFF0000) >> 16, // R
+				 (defaultColor & 0x00FF00) >>  8, // G
+				 (defaultColor & 0x0000FF) );     // B
+  modeData.color2 = strips->Color((defaultColor2 & 0xFF0000) >> 16,
+				  (defaultColor2 & 0x00FF00) >> 8,
+				  (defaultColor2 & 0x0000FF) );
   modeData.wantFade = true;
   modeData.fadeMode = 0;
 
@@ -34,8 +53,8 @@ SimpleStripLights::SimpleStripLights(uint8_t pin, int numLights, runmode default
 SimpleStripLights::~SimpleStripLights()
 {
   delete bufferedInput;
-  delete fader;
-  delete strip;
+  delete strips;
+  free(baseFrame);
 }
 
 /* handleCommands is called from serial or radio data trying to change the 
@@ -47,6 +66,14 @@ void SimpleStripLights::handleCommands(const uint8_t *data, int datalen)
   }
 }
 
+/* How many more bytes handleCommands() can take before update() runs; 
+ * anything past this is dropped, so callers that can hold data back (like
+ * the serial port) should use this to pace themselves. */
+int SimpleStripLights::inputSpaceAvailable()
+{
+  return BUFFERSIZE - bufferedInput->count();
+}
+
 // Ostensibly, we have enough data to perform the given command (or it's an 
 // invalid command). Do our best.
 bool SimpleStripLights::performCommand()
@@ -61,10 +88,10 @@ bool SimpleStripLights::performCommand()
     modeData.fadeMode = pendingCommand[1];
     break;
   case 'c':
-    modeData.color = strip->Color(pendingCommand[1], pendingCommand[2], pendingCommand[3]);
+    modeData.color = strips->Color(pendingCommand[1], pendingCommand[2], pendingCommand[3]);
     break;
   case 'x':
-    modeData.color2 = strip->Color(pendingCommand[1], pendingCommand[2], pendingCommand[3]);
+    modeData.color2 = strips->Color(pendingCommand[1], pendingCommand[2], pendingCommand[3]);
     break;
   case 'C':
     resetMode(ColorMode);
@@ -79,11 +106,11 @@ bool SimpleStripLights::performCommand()
     if (currentMode == RawMode) {
       uint16_t pixelNum = (pendingCommand[1] << 8) | pendingCommand[2];
       if (modeData.wantFade) {
-	fader->setFading(pixelNum, modeData.color);
+	strips->setFading(pixelNum, modeData.color);
 	retval = true;
       } else {
-	fader->stopFading(pixelNum);
-	strip->setPixelColor(pixelNum, modeData.color);
+	strips->stopFading(pixelNum);
+	strips->setPixelColor(pixelNum, modeData.color);
 	retval = true;
       }
     }
@@ -103,47 +130,104 @@ bool SimpleStripLights::performCommand()
   case '!':
     resetMode(ChaseMode);
     break;
+  case 'h':
+    resetMode(RainbowMode);
+    break;
+  case 's':
+    resetMode(SineMode);
+    break;
+  case 'P':
+    resetMode(PlasmaMode);
+    break;
   case 'b': // brightness
     retval = true;
-    strip->setBrightness(pendingCommand[1]);
+    strips->setBrightness(pendingCommand[1]);
+    break;
+  case 'L':
+    retval = pushLayer(pendingCommand[1], pendingCommand[2]);
+    break;
+  case 'l':
+    retval = popLayer();
     break;
   }
 
   return retval;
 }
 
-bool SimpleStripLights::handleInput(byte b)
+// How many bytes long is the command that starts with this byte?
+static byte commandLength(byte opcode)
 {
-  // This is an async data parser; it wastes some RAM to do so, because it 
-  // has to have a buffer that's the maximum size of any command.
-  bool retval = false; // assume no changes to the lights
-
-  pendingCommand[currentCommandSize++] = b;
-
-  // Determine whether or not we have enough data to proceed
-  byte bytesNeeded = 1;
-  switch (pendingCommand[0]) {
-
+  switch (opcode) {
   case 'f': // set fade preference flag
   case 'F': // set fade mode preference flag
   case 'R': // set repeat
   case 'b': // set brightness (0-255)
-    bytesNeeded = 2;
-    break;
+    return 2;
   case '1': // raw mode: set color/fade for a given pixel
-    bytesNeeded = 3;
-    break;
+  case 'L': // push a layer
+    return 3;
   case 'c': // set color preference
   case 'x':
-    bytesNeeded = 4;
-    break;
+    return 4;
+  }
 
-  default:
-    // Otherwise assume it's 1 byte.
-    break;
+  // Otherwise assume it's 1 byte.
+  return 1;
+}
+
+static bool isModeCommand(byte opcode)
+{
+  switch (opcode) {
+  case 'r':
+  case 'C':
+  case 't':
+  case 'T':
+  case 'W':
+  case 'p':
+  case '!':
+  case 'h':
+  case 's':
+  case 'P':
+    return true;
+  }
+  return false;
+}
+
+// Does this mode wipe out everything an earlier mode did - every pixel 
+// and every fader - so that it ends the same whether or not the earlier 
+// one ran? Only the procedural modes do: they stop all the fades and draw
+// every pixel, every frame. ('C' and 'T' paint or clear the strip but 
+// leave running fades to fade out from there, and 'p' restarts the fades
+// without touching the fade mode, so what came before still shows.)
+static bool isRepaintingModeCommand(byte opcode)
+{
+  switch (opcode) {
+  case 'h':
+  case 's':
+  case 'P':
+    return true;
   }
+  return false;
+}
+
+/* Coalescing is on by default; turning it off runs every command in each
+ * batch as it came, which is only useful for checking that coalescing 
+ * doesn't change what the lights end up doing. */
+void SimpleStripLights::setCoalescing(bool enabled)
+{
+  coalescing = enabled;
+}
+
+bool SimpleStripLights::handleInput(byte b)
+{
+  // This is an async data parser; it wastes some RAM to do so, because it 
+  // has to have a buffer that's the maximum size of any command.
+  bool retval = false; // assume no changes to the lights
+
+  pendingCommand[currentCommandSize++] = b;
 
-  if (currentCommandSize == bytesNeeded) {
+  // Determine whether or not we have enough data to proceed
+  if (currentCommandSize == commandLength(pendingCommand[0])) {
     retval = performCommand();
     currentCommandSize = 0;
   }
@@ -156,14 +240,156 @@ bool SimpleStripLights::handleInput(byte b)
   return retval;
 }
 
+/* Remove the commands in data[] that a later command in the same batch
+ * makes pointless, so that (for example) a burst replayed after a radio 
+ * dropout only pays for the final mode switch and the final color. The
+ * batch must start at a command boundary. Returns the new length.
+ *
+ * We work backwards from the newest command, keeping track of which 
+ * settings are about to be overwritten before anything uses them:
+ *   - c, x, f, F and R are dropped if the same setting is changed again
+ *     before it's used ('1' uses c and f; mode switches use c, x and F; 
+ *     'L' uses c, x and R);
+ *   - a mode switch is dropped if the batch ends in a mode that wipes out
+ *     everything it did (cf. isRepaintingModeCommand()), as long as 
+ *     there's no '1' in between (which only works in raw mode);
+ *   - a '1' is dropped if the same pixel is written again later, without 
+ *     a mode switch in between.
+ * b is always kept: it rescales whatever is on the strip, and changing it 
+ * twice can round differently from changing it once.
+ * An incomplete command at the end is left alone. */
+int SimpleStripLights::coalesceCommands(byte *data, int datalen)
+{
+  // Where does each command start? A start of 0xFF means it's dropped.
+  byte starts[BUFFERSIZE];
+  int numCommands = 0;
+  int pos = 0;
+  while (pos < datalen && pos + commandLength(data[pos]) <= datalen) {
+    starts[numCommands++] = pos;
+    pos += commandLength(data[pos]);
+  }
+  int tail = pos; // start of any incomplete command
+
+  bool colorOverwritten = false;
+  bool color2Overwritten = false;
+  bool wantFadeOverwritten = false;
+  bool fadeModeOverwritten = false;
+  bool repeatOverwritten = false;
+  bool modeOverwritten = false;
+  int nextModeSwitch = numCommands; // '1's past here don't supersede
+
+  for (int i=numCommands-1; i>=0; i--) {
+    byte *cmd = &data[starts[i]];
+    bool drop = false;
+
+    switch (cmd[0]) {
+    case 'c':
+      drop = colorOverwritten;
+      colorOverwritten = true;
+      break;
+    case 'x':
+      drop = color2Overwritten;
+      color2Overwritten = true;
+      break;
+    case 'f':
+      drop = wantFadeOverwritten;
+      wantFadeOverwritten = true;
+      break;
+    case 'F':
+      drop = fadeModeOverwritten;
+      fadeModeOverwritten = true;
+      break;
+    case 'R':
+      drop = repeatOverwritten;
+      repeatOverwritten = true;
+      break;
+    case 'L':
+      colorOverwritten = false;
+      color2Overwritten = false;
+      repeatOverwritten = false;
+      break;
+    case '1':
+      for (int j=i+1; j<nextModeSwitch; j++) {
+	if (starts[j] != 0xFF && data[starts[j]] == '1' &&
+	    data[starts[j]+1] == cmd[1] && data[starts[j]+2] == cmd[2]) {
+	  drop = true;
+	  break;
+	}
+      }
+      if (!drop) {
+	colorOverwritten = false;
+	wantFadeOverwritten = false;
+	modeOverwritten = false;
+      }
+      break;
+    default:
+      if (isModeCommand(cmd[0])) {
+	drop = modeOverwritten;
+	if (!drop) {
+	  colorOverwritten = false;
+	  color2Overwritten = false;
+	  fadeModeOverwritten = false;
+	  // Only the batch's last mode gets to draw before anything else 
+	  // happens, so only it can wipe out what came before
+	  modeOverwritten = isRepaintingModeCommand(cmd[0]) &&
+	    (nextModeSwitch == numCommands);
+	  nextModeSwitch = i;
+	}
+      }
+      break;
+    }
+
+    if (drop) {
+      starts[i] = 0xFF;
+    }
+  }
+
+  // Squeeze out the dropped commands, then the incomplete tail
+  int newlen = 0;
+  for (int i=0; i<numCommands; i++) {
+    if (starts[i] != 0xFF) {
+      byte len = commandLength(data[starts[i]]);
+      memmove(&data[newlen], &data[starts[i]], len);
+      newlen += len;
+    }
+  }
+  memmove(&data[newlen], &data[tail], datalen - tail);
+  return newlen + (datalen - tail);
+}
+
+bool SimpleStripLights::handleBufferedInput()
+{
+  bool retval = false;
+
+  // Finish off any command that was split across batches...
+  while (currentCommandSize && bufferedInput->hasData()) {
+    retval |= handleInput(bufferedInput->consumeByte());
+  }
+
+  // ... and then coalesce the rest before running it.
+  byte batch[BUFFERSIZE];
+  int len = 0;
+  while (len < BUFFERSIZE && bufferedInput->hasData()) {
+    batch[len++] = bufferedInput->consumeByte();
+  }
+  if (coalescing) {
+    len = coalesceCommands(batch, len);
+  }
+
+  for (int i=0; i<len; i++) {
+    retval |= handleInput(batch[i]);
+  }
+  return retval;
+}
+
 /* update() is to be called periodically to update any animations in play. */
 void SimpleStripLights::update()
 {
   bool changes = false;
 
   /* If we have input, then handle it */
-  while (bufferedInput->hasData()) {
-    changes |= handleInput(bufferedInput->consumeByte());
+  if (bufferedInput->hasData()) {
+    changes |= handleBufferedInput();
   }
 
   /* Deal with maintenance of the modes */
@@ -172,6 +398,8 @@ void SimpleStripLights::update()
     break;
   case RawMode:
     break;
+  case ColorMode:
+    break;
   case TwinkleMode:
     changes |= twinkle();
     break;
@@ -185,14 +413,98 @@ void SimpleStripLights::update()
   case TardisMode:
     changes |= tardis();
     break;
+  case RainbowMode:
+    changes |= procedural(RainbowEffect::opcode);
+    break;
+  case SineMode:
+    changes |= procedural(SineEffect::opcode);
+    break;
+  case PlasmaMode:
+    changes |= procedural(PlasmaEffect::opcode);
+    break;
   }
 
   /* Deal with maintenance of the faders */
-  changes |= fader->performFade();
+  changes |= strips->performFade();
+
+  /* The layers move on their own, even if nothing underneath them did */
+  if (numLayers && millis() >= nextLayerMillis) {
+    changes = true;
+    nextLayerMillis = millis() + 20;
+  }
 
   /* If there are changes, then update the strips */
   if (changes) {
-    strip->show();
+    present();
+  }
+}
+
+/* isQuiescent() tells the caller whether update() has nothing to do right
+ * now. If so, *wakeAt is the millis() at which it next will (IDLE_FOREVER
+ * if the lights are static), so the caller can sleep until then or until 
+ * more input arrives, whichever comes first. */
+bool SimpleStripLights::isQuiescent(unsigned long *wakeAt)
+{
+  if (bufferedInput->hasData()) {
+    return false;
+  }
+
+  unsigned long modeWakeAt = IDLE_FOREVER;
+  switch (currentMode) {
+  case InvalidMode:
+  case RawMode:
+  case ColorMode:
+    // Nothing moves but the fades
+    break;
+  case PulseMode:
+    // pulse() restarts any pixel that has stopped fading, as soon as it can
+    if (strips->countFading() < numLights) {
+      return false;
+    }
+    break;
+  case TwinkleMode:
+  case WipeMode:
+  case ChaseMode:
+  case TardisMode:
+  case RainbowMode:
+  case SineMode:
+  case PlasmaMode:
+    modeWakeAt = nextMillis;
+    break;
+  }
+
+  if (numLayers) {
+    modeWakeAt = min(modeWakeAt, nextLayerMillis);
+  }
+
+  *wakeAt = min(modeWakeAt, strips->nextFadeMillis());
+  return (*wakeAt > millis());
+}
+
+/* Record every frame that's shown from here on to the given trace (or stop
+ * recording, if it's NULL). The caller still owns the trace. */
+void SimpleStripLights::setFrameTrace(FrameTrace *trace)
+{
+  this->trace = trace;
+}
+
+void SimpleStripLights::present()
+{
+  // The layers are only drawn for showing. Afterwards the strip goes back 
+  // to the way the mode left it, since that's what the mode and the faders 
+  // carry on from.
+  if (numLayers) {
+    strips->saveFrame(baseFrame);
+    compositeLayers();
+  }
+
+  strips->show();
+  if (trace) {
+    trace->record(strips);
+  }
+
+  if (numLayers) {
+    strips->restoreFrame(baseFrame);
   }
 }
 
@@ -204,7 +516,7 @@ void SimpleStripLights::resetMode(runmode newMode)
   /* Reset local variables for each mode */
   switch (newMode) {
   case TwinkleMode:
-    strip->clear();
+    strips->clear();
     break;
   case WipeMode:
   case ChaseMode:
@@ -215,11 +527,24 @@ void SimpleStripLights::resetMode(runmode newMode)
     break;
   case ColorMode:
     {
-        for (int i=0; i<numLights; i++) {
-          strip->setPixelColor(i, modeData.color);
+        for (pixelnum_t i=0; i<numLights; i++) {
+          strips->setPixelColor(i, modeData.color);
         }
-        strip->show();
+        present();
     }
+    break;
+  case RainbowMode:
+  case SineMode:
+  case PlasmaMode:
+    // These draw every pixel themselves; any fades in progress would just
+    // fight them.
+    strips->stopAllFading();
+    break;
+  case InvalidMode:
+  case RawMode:
+  case TardisMode:
+    // Nothing of their own to set up
+    break;
   }
 
   // If we're going in to raw mode, let the fades finish as-was. Otherwise 
@@ -227,13 +552,13 @@ void SimpleStripLights::resetMode(runmode newMode)
   // Also don't touch faders for PulseMode, which just did that...
   if (newMode != RawMode && 
       newMode != PulseMode) {
-    fader->reset();
+    strips->reset();
     if (modeData.fadeMode == 0) {
       // default fade mode
-      fader->setFadeMode(newMode == WipeMode);
+      strips->setFadeMode(newMode == WipeMode);
     } else {
       // inverse of default fade mode
-      fader->setFadeMode(newMode != WipeMode);
+      strips->setFadeMode(newMode != WipeMode);
     }
   }
 }
@@ -244,16 +569,16 @@ void SimpleStripLights::setupPulseMode()
   uint8_t phase = 0;
   bool usingPrimaryColor = true;
 
-  for (uint16_t i=0; i<numLights; i++) {
+  for (pixelnum_t i=0; i<numLights; i++) {
     phase++;
 
-    fader->setFading(i, usingPrimaryColor ? modeData.color : modeData.color2);
+    strips->setFading(i, usingPrimaryColor ? modeData.color : modeData.color2);
 
-    for (uint8_t j=0; j<=phase; j++) {
-      fader->stepOnePixel(i);
-      if (fader->isFading(i) == 0) {
+    for (uint16_t j=0; j<=phase; j++) {
+      strips->stepOnePixel(i);
+      if (strips->isFading(i) == 0) {
 	usingPrimaryColor =!usingPrimaryColor;
-	fader->setFading(i, usingPrimaryColor ? modeData.color : modeData.color2);
+	strips->setFading(i, usingPrimaryColor ? modeData.color : modeData.color2);
 	phase = 1;
       }
     }
@@ -265,8 +590,8 @@ int SimpleStripLights::findRandomUnfadedPixel()
 {
   // Try to find a random unfaded pixel 10 times. If we fail, then return -1.
   for (int i=0; i<10; i++) {
-    uint8_t pixelNum = random(0, numLights-1);
-    if (fader->isFading(pixelNum) == false) {
+    pixelnum_t pixelNum = random(0, numLights-1);
+    if (strips->isFading(pixelNum) == false) {
       return pixelNum;
     }
   }
@@ -279,17 +604,17 @@ bool SimpleStripLights::twinkle()
 
   if (millis() >= nextMillis) {
     for (int lightcount = 0; lightcount < 6; lightcount++) { // FIXME: constant. Light 6 lights per loop iteration.
-      if (fader->countFading() < MAX_TWINKLE_LIT) {
+      if (strips->countFading() < MAX_TWINKLE_LIT) {
         // Light another if we can!
         int idx = findRandomUnfadedPixel();
         if (idx != -1) {
           didChangeAnything = true;
           if (random(0,2) == 0) {
             // fade to white
-            fader->setFading(idx, modeData.color2);
+            strips->setFading(idx, modeData.color2);
           } else {
             // Fade to the second color
-	    fader->setFading(idx, modeData.color);
+	    strips->setFading(idx, modeData.color);
           }
         }
       }
@@ -299,25 +624,51 @@ bool SimpleStripLights::twinkle()
   return didChangeAnything;
 }
 
-bool SimpleStripLights::pulse()
+struct _PulseJob {
+  StripGroup *strips;
+  uint32_t color, color2;
+  uint8_t reducedColor;
+};
+
+static void pulseRange(void *ctx, pixelnum_t first, pixelnum_t count)
 {
-  // If any pixel hit black, then swap its color.
-  for (uint16_t i=0; i<numLights; i++) {
-    if (fader->isFading(i) == 0) {
-      if (fader->get8bitTargetColor(i) == 
-	  fader->reduceColorTo8bit(modeData.color)) {
-	fader->setFading(i, modeData.color2);
+  struct _PulseJob *j = (struct _PulseJob *)ctx;
+  for (pixelnum_t i=first; i<first+count; i++) {
+    if (j->strips->isFading(i) == 0) {
+      if (j->strips->get8bitTargetColor(i) == j->reducedColor) {
+	j->strips->setFading(i, j->color2);
       } else {
-	fader->setFading(i, modeData.color);
+	j->strips->setFading(i, j->color);
       }
     }
   }
 }
 
+bool SimpleStripLights::pulse()
+{
+  // If any pixel hit black, then swap its color.
+  if (strips->countFading() == numLights) {
+    return false;
+  }
+  struct _PulseJob j;
+  j.strips = strips;
+  j.color = modeData.color;
+  j.color2 = modeData.color2;
+  j.reducedColor = strips->reduceColorTo8bit(modeData.color);
+  strips->forEachRange(pulseRange, &j);
+  return true;
+}
+
 bool SimpleStripLights::wipe()
 {
+  if (numLights == 0) {
+    // Nothing to wipe; we'd never reach the end
+    resetMode(RawMode);
+    return false;
+  }
+
   if (millis() >= nextMillis) {
-    fader->setFading(modeData.mode.wipe.pos, modeData.color);
+    strips->setFading(modeData.mode.wipe.pos, modeData.color);
     if (modeData.mode.wipe.pos == numLights-1) {
       if ((currentMode == ChaseMode) && (modeData.repeat != 0)) {
         if (modeData.repeat > 0) {
@@ -343,12 +694,145 @@ bool SimpleStripLights::tardis()
 {
   // Whenever the fader finishes fading everything out, start it over again
   if (millis() >= nextMillis) {
-    if (!fader->areAnyFading()) {
-      for (int i=0; i<numLights; i++) {
-	fader->setFading(i, modeData.color);
+    if (!strips->areAnyFading()) {
+      for (pixelnum_t i=0; i<numLights; i++) {
+	strips->setFading(i, modeData.color);
       }
+      nextMillis = millis() + 150;
+      return true;
     }
     nextMillis = millis() + 150;
   }
+  return false;
+}
+
+// The time phase shared by the procedural modes and layers. The repeat 
+// preference ('R') doubles as their speed: 1 (the default) is a full cycle 
+// every 2.56 seconds, and larger values are proportionally faster.
+uint8_t SimpleStripLights::proceduralPhase(int8_t repeat)
+{
+  uint8_t speed = (repeat > 0) ? repeat : 1;
+  return (millis() / 10) * speed;
+}
+
+struct _ProceduralJob {
+  StripGroup *strips;
+  EffectKernel kernel;
+  struct _EffectParams params;
+};
+
+static void proceduralRange(void *ctx, pixelnum_t first, pixelnum_t count)
+{
+  struct _ProceduralJob *j = (struct _ProceduralJob *)ctx;
+  uint32_t colors[EFFECT_TILE] = { 0 };
+  while (count) {
+    uint8_t n = (count < EFFECT_TILE) ? count : EFFECT_TILE;
+    j->kernel(j->params, first, n, colors);
+    for (uint8_t k=0; k<n; k++) {
+      j->strips->setPixelColor(first + k, colors[k]);
+    }
+    first += n;
+    count -= n;
+  }
+}
+
+// Draw one of the Effects over the whole strip, for the procedural modes.
+bool SimpleStripLights::procedural(uint8_t effect)
+{
+  if (millis() >= nextMillis) {
+    struct _ProceduralJob j;
+    j.strips = strips;
+    j.kernel = Effects::kernel(effect, BlendReplace);
+    j.params.phase = proceduralPhase(modeData.repeat);
+    j.params.color = modeData.color;
+    j.params.color2 = modeData.color2;
+    strips->forEachRange(proceduralRange, &j);
+    nextMillis = millis() + 20;
+    return true;
+  }
+  return false;
+}
+
+// Push a layer onto the stack, using the current colors and speed. Returns 
+// false if the stack is full, or there's no such effect or blendop.
+bool SimpleStripLights::pushLayer(uint8_t effect, uint8_t blend)
+{
+  EffectKernel kernel = Effects::kernel(effect, blend);
+  if (numLayers >= MAX_LAYERS || !kernel) {
+    return false;
+  }
+
+  if (!baseFrame) {
+    // Room to keep the modes' own frame while the layers are drawn over it
+    baseFrame = (uint8_t*)malloc(numLights * 3);
+    if (!baseFrame) {
+      return false;
+    }
+  }
+
+  struct _Layer *l = &layers[numLayers++];
+  l->kernel = kernel;
+  l->speed = modeData.repeat;
+  l->params.color = modeData.color;
+  l->params.color2 = modeData.color2;
+  nextLayerMillis = 0;
+  return true;
+}
+
+bool SimpleStripLights::popLayer()
+{
+  if (numLayers == 0) {
+    return false;
+  }
+
+  numLayers--;
+  if (numLayers == 0) {
+    free(baseFrame);
+    baseFrame = NULL;
+  }
+  return true;
 }
 
+struct _LayerJob {
+  StripGroup *strips;
+  const struct _Layer *layers;
+  uint8_t numLayers;
+};
+
+// A tile at a time: each layer's kernel draws over the whole tile in 
+// turn, and the tile goes back to the strip once they all have.
+static void layerRange(void *ctx, pixelnum_t first, pixelnum_t count)
+{
+  struct _LayerJob *lj = (struct _LayerJob *)ctx;
+  uint32_t colors[EFFECT_TILE];
+  while (count) {
+    uint8_t n = (count < EFFECT_TILE) ? count : EFFECT_TILE;
+    for (uint8_t k=0; k<n; k++) {
+      colors[k] = lj->strips->getPixelColor(first + k);
+    }
+    for (uint8_t j=0; j<lj->numLayers; j++) {
+      const struct _Layer *l = &lj->layers[j];
+      l->kernel(l->params, first, n, colors);
+    }
+    for (uint8_t k=0; k<n; k++) {
+      lj->strips->setPixelColor(first + k, colors[k]);
+    }
+    first += n;
+    count -= n;
+  }
+}
+
+// Draw every layer, bottom to top, over what the mode drew - in one pass
+// over the pixels, with each tile of them finished before the next.
+void SimpleStripLights::compositeLayers()
+{
+  for (uint8_t j=0; j<numLayers; j++) {
+    layers[j].params.phase = proceduralPhase(layers[j].speed);
+  }
+
+  struct _LayerJob lj;
+  lj.strips = strips;
+  lj.layers = layers;
+  lj.numLayers = numLayers;
+  strips->forEachRange(layerRange, &lj);
+}
@@ -1,10 +1,16 @@
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
-#include "Fader8bit.h"
+#include "StripGroup.h"
+#include "ProceduralEffects.h"
+#include "FrameTrace.h"
 #include <RingBuffer.h>
 
+#ifndef __SIMPLESTRIPLIGHTS_H
+#define __SIMPLESTRIPLIGHTS_H
+
 #define MAX_TWINKLE_LIT ((2*numLights)/3)
 #define MAX_COMMAND_SIZE 6
+#define MAX_LAYERS 4
 
 enum runmode {
   InvalidMode = -1,
@@ -14,7 +20,10 @@ enum runmode {
   ChaseMode,
   TardisMode,
   ColorMode,
-  PulseMode
+  PulseMode,
+  RainbowMode,
+  SineMode,
+  PlasmaMode
 };
 
 struct _ModeData {
@@ -25,40 +34,69 @@ struct _ModeData {
   byte fadeMode;
   union _mode {
     struct _wipe {
-      uint8_t pos;
+      pixelnum_t pos;
     } wipe;
   } mode;
 };
 
+// An effect drawn over the top of whatever the current mode is doing
+struct _Layer {
+  EffectKernel kernel; // its effect and blendop, from Effects::kernel()
+  int8_t speed;        // cf. proceduralPhase
+  struct _EffectParams params;
+};
+
 class SimpleStripLights {
  public:
   SimpleStripLights(uint8_t pin, int numLights, runmode defaultMode = WipeMode, uint32_t defaultColor = 0x000000F0, uint32_t defaultColor2 = 0xFFFFC4); // defaultColor is xxRRGGBB. 0xFFFFC4 is a pleasing white on my test strips.
+  // Drive a group of strips as one. Takes ownership of the group.
+  SimpleStripLights(StripGroup *group, runmode defaultMode = WipeMode, uint32_t defaultColor = 0x000000F0, uint32_t defaultColor2 = 0xFFFFC4);
 
   ~SimpleStripLights();
 
   void update();
   void handleCommands(const uint8_t *data, int datalen);
+  int inputSpaceAvailable();
+  bool isQuiescent(unsigned long *wakeAt);
   void resetMode(runmode newMode);
   void setupPulseMode();
+  void setFrameTrace(FrameTrace *trace);
+  bool pushLayer(uint8_t effect, uint8_t blend);
+  bool popLayer();
+  void setCoalescing(bool enabled);
   
 
  private:
+  void init(runmode defaultMode, uint32_t defaultColor, uint32_t defaultColor2);
+  void present();
   bool performCommand();
   bool handleInput(byte b);
+  bool handleBufferedInput();
+  int coalesceCommands(byte *data, int datalen);
   int findRandomUnfadedPixel();
   bool twinkle();
   bool pulse();
   bool wipe();
   bool tardis();
+  bool procedural(uint8_t effect);
+  uint8_t proceduralPhase(int8_t repeat);
+  void compositeLayers();
 
  private:
-  Adafruit_NeoPixel *strip;
+  StripGroup *strips;
+  FrameTrace *trace;
   runmode currentMode;
   unsigned long nextMillis;
   struct _ModeData modeData;
-  Fader8bit *fader = NULL;
-  int numLights;
+  pixelnum_t numLights;
   RingBuffer *bufferedInput;
   byte pendingCommand[MAX_COMMAND_SIZE];
   byte currentCommandSize;
+  struct _Layer layers[MAX_LAYERS];
+  uint8_t numLayers;
+  uint8_t *baseFrame;
+  unsigned long nextLayerMillis;
+  bool coalescing;
 };
+
+#endif
@@ -0,0 +1,403 @@
+#include "StripGroup.h"
+
+StripGroup::StripGroup()
+{
+  this->numSegments = 0;
+  this->totalPixels = 0;
+  this->chunks = NULL;
+  this->numChunks = 0;
+#ifdef STRIPGROUP_THREADS
+  this->pool = new WorkerPool(STRIPGROUP_THREADS);
+#endif
+#ifdef __unix__
+  this->preview = NULL;
+#endif
+}
+
+StripGroup::~StripGroup()
+{
+#ifdef STRIPGROUP_THREADS
+  delete this->pool;
+#endif
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    delete this->chunks[i].fader;
+  }
+  free(this->chunks);
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    delete this->segments[i].strip;
+  }
+}
+
+// Add another strip to the end of the group. Its pixels are numbered
+// directly after the pixels of the previous strip.
+bool StripGroup::addStrip(uint8_t pin, uint16_t numLights)
+{
+  if (this->numSegments >= MAX_STRIPS || numLights == 0 ||
+      (pixelnum_t)(this->totalPixels + numLights) < this->totalPixels) {
+    return false;
+  }
+
+  uint16_t newChunks = (numLights + FADER_PIXELS - 1) / FADER_PIXELS;
+  struct _Chunk *c = (struct _Chunk *)realloc(this->chunks, 
+		     (this->numChunks + newChunks) * sizeof(struct _Chunk));
+  if (!c) {
+    return false;
+  }
+  this->chunks = c;
+
+  struct _Segment *s = &this->segments[this->numSegments++];
+  s->strip = new Adafruit_NeoPixel(numLights, pin, NEO_GRB | NEO_KHZ800);
+  s->strip->begin();
+  s->strip->show();
+  s->firstPixel = this->totalPixels;
+  s->numPixels = numLights;
+  s->firstChunk = this->numChunks;
+
+  for (uint16_t first=0; first<numLights; first+=FADER_PIXELS) {
+    c = &this->chunks[this->numChunks++];
+    c->fader = new Fader8bit(s->strip, first, 
+			     min(numLights - first, FADER_PIXELS));
+    c->firstPixel = this->totalPixels + first;
+  }
+
+  this->totalPixels += numLights;
+  return true;
+}
+
+uint8_t StripGroup::numStrips()
+{
+  return this->numSegments;
+}
+
+pixelnum_t StripGroup::numPixels()
+{
+  return this->totalPixels;
+}
+
+struct StripGroup::_Segment *StripGroup::segmentFor(pixelnum_t *pixelNum)
+{
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    if (*pixelNum < this->segments[i].numPixels) {
+      return &this->segments[i];
+    }
+    *pixelNum -= this->segments[i].numPixels;
+  }
+  return NULL;
+}
+
+Fader8bit *StripGroup::faderFor(pixelnum_t pixelNum, uint8_t *faderPixel)
+{
+  struct _Segment *s = segmentFor(&pixelNum);
+  if (!s) {
+    return NULL;
+  }
+  // Most strips are only one chunk long; skip the division for those
+  if (pixelNum < FADER_PIXELS) {
+    *faderPixel = pixelNum;
+    return this->chunks[s->firstChunk].fader;
+  }
+  uint16_t chunk = pixelNum / FADER_PIXELS;
+  *faderPixel = pixelNum - chunk * FADER_PIXELS;
+  return this->chunks[s->firstChunk + chunk].fader;
+}
+
+uint32_t StripGroup::Color(uint8_t r, uint8_t g, uint8_t b)
+{
+  return Adafruit_NeoPixel::Color(r, g, b);
+}
+
+void StripGroup::setPixelColor(pixelnum_t pixelNum, uint32_t c)
+{
+  struct _Segment *s = segmentFor(&pixelNum);
+  if (s) {
+    s->strip->setPixelColor(pixelNum, c);
+  }
+}
+
+uint32_t StripGroup::getPixelColor(pixelnum_t pixelNum)
+{
+  struct _Segment *s = segmentFor(&pixelNum);
+  if (s) {
+    return s->strip->getPixelColor(pixelNum);
+  }
+  return 0;
+}
+
+void StripGroup::clear()
+{
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    this->segments[i].strip->clear();
+  }
+}
+
+void StripGroup::setBrightness(uint8_t b)
+{
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    this->segments[i].strip->setBrightness(b);
+  }
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    this->chunks[i].fader->brightnessChanged();
+  }
+}
+
+void StripGroup::show()
+{
+#ifdef __unix__
+  if (this->preview) {
+    // Publish the frame instead: each strip's raw buffer, back to back
+    uint8_t *frame = this->preview->beginFrame();
+    for (uint8_t i=0; i<this->numSegments; i++) {
+      memcpy(frame, this->segments[i].strip->getPixels(), 
+	     this->segments[i].numPixels * 3);
+      frame += this->segments[i].numPixels * 3;
+    }
+    this->preview->endFrame();
+    return;
+  }
+#endif
+
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    this->segments[i].strip->show();
+  }
+}
+
+#ifdef __unix__
+// On a host build, send frames to a shared-memory ring (which must have room
+// for 3 bytes per pixel) instead of to the strips. NULL goes back to the 
+// strips. The caller still owns the ring.
+bool StripGroup::setPreviewOutput(ShmFrameRing *ring)
+{
+  if (ring && (!ring->isOpen() || 
+	       ring->frameBytes() < (uint32_t)this->totalPixels * 3)) {
+    return false;
+  }
+  this->preview = ring;
+  return true;
+}
+#endif
+
+// Copy every strip's raw pixel buffer out to buf (3 bytes per pixel), or
+// back in again. These are exact copies - unlike getPixelColor(), they 
+// don't lose anything to the brightness setting.
+void StripGroup::saveFrame(uint8_t *buf)
+{
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    memcpy(buf, this->segments[i].strip->getPixels(), 
+	   this->segments[i].numPixels * 3);
+    buf += this->segments[i].numPixels * 3;
+  }
+}
+
+void StripGroup::restoreFrame(const uint8_t *buf)
+{
+  for (uint8_t i=0; i<this->numSegments; i++) {
+    memcpy(this->segments[i].strip->getPixels(), buf, 
+	   this->segments[i].numPixels * 3);
+    buf += this->segments[i].numPixels * 3;
+  }
+}
+
+// One strip's raw pixel buffer, the way saveFrame() sees it, and how many
+// pixels are in it.
+uint8_t *StripGroup::getPixels(uint8_t strip, uint16_t *numPixels)
+{
+  if (strip >= this->numSegments) {
+    *numPixels = 0;
+    return NULL;
+  }
+  *numPixels = this->segments[strip].numPixels;
+  return this->segments[strip].strip->getPixels();
+}
+
+void StripGroup::reset()
+{
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    this->chunks[i].fader->reset();
+  }
+}
+
+bool StripGroup::isFading(pixelnum_t pixelNum)
+{
+  uint8_t p;
+  Fader8bit *f = faderFor(pixelNum, &p);
+  return (f && f->isFading(p));
+}
+
+void StripGroup::setFading(pixelnum_t pixelNum, uint32_t c)
+{
+  uint8_t p;
+  Fader8bit *f = faderFor(pixelNum, &p);
+  if (f) {
+    f->setFading(p, c);
+  }
+}
+
+void StripGroup::stopFading(pixelnum_t pixelNum)
+{
+  uint8_t p;
+  Fader8bit *f = faderFor(pixelNum, &p);
+  if (f) {
+    f->stopFading(p);
+  }
+}
+
+void StripGroup::stopAllFading()
+{
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    this->chunks[i].fader->stopAllFading();
+  }
+}
+
+pixelnum_t StripGroup::countFading()
+{
+  pixelnum_t count = 0;
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    count += this->chunks[i].fader->countFading();
+  }
+  return count;
+}
+
+bool StripGroup::areAnyFading()
+{
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    if (this->chunks[i].fader->areAnyFading()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// When performFade() next has work to do: the soonest step of any chunk
+// that's fading, or IDLE_FOREVER if none are.
+unsigned long StripGroup::nextFadeMillis()
+{
+  unsigned long retval = IDLE_FOREVER;
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    if (this->chunks[i].fader->areAnyFading()) {
+      retval = min(retval, this->chunks[i].fader->nextFadeMillis());
+    }
+  }
+  return retval;
+}
+
+void StripGroup::setFadeMode(bool fadeInOnly)
+{
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    this->chunks[i].fader->setFadeMode(fadeInOnly);
+  }
+}
+
+uint8_t StripGroup::reduceColorTo8bit(uint32_t rgb)
+{
+  // All of the faders reduce colors the same way (even if there aren't any)
+  return Fader8bit::reduceColorTo8bit(rgb);
+}
+
+uint8_t StripGroup::get8bitTargetColor(pixelnum_t pixelNum)
+{
+  uint8_t p;
+  Fader8bit *f = faderFor(pixelNum, &p);
+  if (f) {
+    return f->get8bitTargetColor(p);
+  }
+  return 0;
+}
+
+bool StripGroup::stepOnePixel(pixelnum_t pixelNum)
+{
+  uint8_t p;
+  Fader8bit *f = faderFor(pixelNum, &p);
+  return (f && f->stepOnePixel(p));
+}
+
+#ifdef STRIPGROUP_THREADS
+// Use a different number of worker threads from now on (including the
+// calling thread; 1 means do everything on the caller).
+bool StripGroup::setWorkerThreads(uint8_t numThreads)
+{
+  if (numThreads < 1 || numThreads > MAX_WORKERS) {
+    return false;
+  }
+  delete this->pool;
+  this->pool = new WorkerPool(numThreads);
+  return true;
+}
+
+// Each worker gets a contiguous run of numChunks/numWorkers chunks (the 
+// first ones get one extra if it doesn't divide evenly).
+static void chunkShare(uint16_t numChunks, uint8_t worker, uint8_t numWorkers,
+		       uint16_t *first, uint16_t *count)
+{
+  uint16_t each = numChunks / numWorkers;
+  uint16_t extra = numChunks % numWorkers;
+  *first = worker * each + min((uint16_t)worker, extra);
+  *count = each + (worker < extra ? 1 : 0);
+}
+
+void StripGroup::fadeChunks(void *ctx, uint8_t worker, uint8_t numWorkers)
+{
+  StripGroup *g = (StripGroup *)ctx;
+  uint16_t first, count;
+  bool changed = false;
+
+  chunkShare(g->numChunks, worker, numWorkers, &first, &count);
+  for (uint16_t i=first; i<first+count; i++) {
+    changed |= g->chunks[i].fader->performFade();
+  }
+  g->poolChanged[worker] = changed;
+}
+
+void StripGroup::rangeChunks(void *ctx, uint8_t worker, uint8_t numWorkers)
+{
+  StripGroup *g = (StripGroup *)ctx;
+  uint16_t first, count;
+
+  chunkShare(g->numChunks, worker, numWorkers, &first, &count);
+  if (count) {
+    pixelnum_t firstPixel = g->chunks[first].firstPixel;
+    pixelnum_t endPixel = (first + count < g->numChunks) ?
+      g->chunks[first + count].firstPixel : g->totalPixels;
+    g->poolJob(g->poolCtx, firstPixel, endPixel - firstPixel);
+  }
+}
+#endif
+
+void StripGroup::forEachRange(rangejob job, void *ctx)
+{
+#ifdef STRIPGROUP_THREADS
+  if (this->pool->numWorkers() > 1 && this->numChunks > 1) {
+    this->poolJob = job;
+    this->poolCtx = ctx;
+    this->pool->run(&StripGroup::rangeChunks, this);
+    return;
+  }
+#endif
+
+  job(ctx, 0, this->totalPixels);
+}
+
+// One step of the fades on every strip. Returns true if any LEDs changed.
+bool StripGroup::performFade()
+{
+  bool retval = false;
+
+  // Don't bother waking the workers (or walking the chunks) for nothing
+  if (millis() < nextFadeMillis()) {
+    return false;
+  }
+
+#ifdef STRIPGROUP_THREADS
+  if (this->pool->numWorkers() > 1 && this->numChunks > 1) {
+    this->pool->run(&StripGroup::fadeChunks, this);
+    for (uint8_t w=0; w<this->pool->numWorkers(); w++) {
+      retval |= this->poolChanged[w];
+    }
+    return retval;
+  }
+#endif
+
+  for (uint16_t i=0; i<this->numChunks; i++) {
+    retval |= this->chunks[i].fader->performFade();
+  }
+  return retval;
+}
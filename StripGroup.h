@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include "Fader8bit.h"
+#include "ShmFrameRing.h"
+#include "WorkerPool.h"
+
+#ifndef __STRIPGROUP_H
+#define __STRIPGROUP_H
+
+/*
+ * A StripGroup is a set of physical strips (one Adafruit_NeoPixel per
+ * output pin) that the rest of the engine treats as one long strip. 
+ *
+ * Fader8bit is bound to byte-sized pixel numbers, so each strip is split 
+ * into chunks of up to FADER_PIXELS pixels with a Fader8bit apiece. A strip
+ * can be as long as Adafruit_NeoPixel allows (65535 pixels), and the group
+ * as a whole is addressed with pixelnum_t: 16 bits on an MCU, where RAM 
+ * runs out long before that does, and 32 bits on a host build.
+ *
+ * The pixel methods mirror Adafruit_NeoPixel, and the fade methods mirror
+ * Fader8bit, so SimpleStripLights can drive a group exactly the way it
+ * used to drive a single strip.
+ *
+ * The chunks don't share any pixels or fader state, so work on different
+ * chunks can happen at the same time. forEachRange() hands a job contiguous
+ * ranges of pixels that each cover whole chunks. On a controller that has 
+ * threads, define STRIPGROUP_THREADS to the number of worker threads and 
+ * forEachRange() and performFade() spread the chunks over a WorkerPool;
+ * otherwise (on an MCU) the one range is the whole group. Either way they 
+ * only return when every range is done, so show() is the single 
+ * synchronized present.
+ */
+
+#ifdef __AVR__
+typedef uint16_t pixelnum_t;
+#else
+typedef uint32_t pixelnum_t;
+#endif
+
+// The most pixels one Fader8bit looks after
+#define FADER_PIXELS 255
+
+#define MAX_STRIPS 8
+
+// A deadline that never comes (nothing to do until something changes)
+#define IDLE_FOREVER ((unsigned long)-1)
+
+class StripGroup {
+ public:
+  StripGroup();
+  ~StripGroup();
+
+  bool addStrip(uint8_t pin, uint16_t numLights);
+
+  uint8_t numStrips();
+  pixelnum_t numPixels();
+
+  // Call job(ctx, first, count) for ranges of pixels that cover the whole
+  // group, each made of whole Fader8bit chunks; they may run at the same 
+  // time. Returns once all of them are done.
+  typedef void (*rangejob)(void *ctx, pixelnum_t first, pixelnum_t count);
+  void forEachRange(rangejob job, void *ctx);
+#ifdef STRIPGROUP_THREADS
+  bool setWorkerThreads(uint8_t numThreads);
+#endif
+
+  // Pixel methods, over the whole group
+  uint32_t Color(uint8_t r, uint8_t g, uint8_t b);
+  void setPixelColor(pixelnum_t pixelNum, uint32_t c);
+  uint32_t getPixelColor(pixelnum_t pixelNum);
+  void clear();
+  void setBrightness(uint8_t b);
+  void show();
+  void saveFrame(uint8_t *buf);
+  void restoreFrame(const uint8_t *buf);
+  uint8_t *getPixels(uint8_t strip, uint16_t *numPixels);
+#ifdef __unix__
+  bool setPreviewOutput(ShmFrameRing *ring);
+#endif
+
+  // Fade methods, over the whole group
+  void reset();
+  bool isFading(pixelnum_t pixelNum);
+  void setFading(pixelnum_t pixelNum, uint32_t c);
+  void stopFading(pixelnum_t pixelNum);
+  void stopAllFading();
+  pixelnum_t countFading();
+  bool areAnyFading();
+  unsigned long nextFadeMillis();
+  void setFadeMode(bool fadeInOnly);
+  uint8_t reduceColorTo8bit(uint32_t rgb);
+  uint8_t get8bitTargetColor(pixelnum_t pixelNum);
+  bool stepOnePixel(pixelnum_t pixelNum);
+  bool performFade();
+
+ private:
+  struct _Segment {
+    Adafruit_NeoPixel *strip;
+    pixelnum_t firstPixel;
+    uint16_t numPixels;
+    uint16_t firstChunk;
+  };
+
+  // A window of up to FADER_PIXELS pixels in one strip, with its own fader
+  struct _Chunk {
+    Fader8bit *fader;
+    pixelnum_t firstPixel; // within the group
+  };
+
+  // Find the segment that holds the given pixel, and rewrite pixelNum to be
+  // the index within that segment
+  struct _Segment *segmentFor(pixelnum_t *pixelNum);
+
+  // Find the fader that looks after the given pixel, and its index there
+  Fader8bit *faderFor(pixelnum_t pixelNum, uint8_t *faderPixel);
+
+#ifdef STRIPGROUP_THREADS
+  static void fadeChunks(void *ctx, uint8_t worker, uint8_t numWorkers);
+  static void rangeChunks(void *ctx, uint8_t worker, uint8_t numWorkers);
+#endif
+
+ private:
+  struct _Segment segments[MAX_STRIPS];
+  uint8_t numSegments;
+  pixelnum_t totalPixels;
+  struct _Chunk *chunks;
+  uint16_t numChunks;
+#ifdef STRIPGROUP_THREADS
+  WorkerPool *pool;
+  rangejob poolJob;
+  void *poolCtx;
+  bool poolChanged[MAX_WORKERS];
+#endif
+#ifdef __unix__
+  ShmFrameRing *preview;
+#endif
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "WorkerPool.h"
+
+#ifdef STRIPGROUP_THREADS
+
+WorkerPool::WorkerPool(uint8_t numWorkers)
+{
+  if (numWorkers < 1) {
+    numWorkers = 1;
+  } else if (numWorkers > MAX_WORKERS) {
+    numWorkers = MAX_WORKERS;
+  }
+
+  this->count = numWorkers;
+  this->generation = 0;
+  this->busy = 0;
+  this->quit = false;
+  this->job = NULL;
+  this->ctx = NULL;
+
+  // The caller is worker 0, so it needs one thread fewer
+  this->threads = new std::thread[numWorkers - 1];
+  for (uint8_t w=1; w<numWorkers; w++) {
+    this->threads[w-1] = std::thread(&WorkerPool::workerLoop, this, w);
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> l(this->lock);
+    this->quit = true;
+  }
+  this->wake.notify_all();
+  for (uint8_t w=1; w<this->count; w++) {
+    this->threads[w-1].join();
+  }
+  delete[] this->threads;
+}
+
+uint8_t WorkerPool::numWorkers()
+{
+  return this->count;
+}
+
+void WorkerPool::run(job_t job, void *ctx)
+{
+  if (this->count > 1) {
+    std::lock_guard<std::mutex> l(this->lock);
+    this->job = job;
+    this->ctx = ctx;
+    this->busy = this->count - 1;
+    this->generation++;
+  }
+  this->wake.notify_all();
+
+  job(ctx, 0, this->count);
+
+  std::unique_lock<std::mutex> l(this->lock);
+  while (this->busy) {
+    this->done.wait(l);
+  }
+}
+
+void WorkerPool::workerLoop(uint8_t worker)
+{
+  unsigned long seen = 0;
+
+  std::unique_lock<std::mutex> l(this->lock);
+  while (1) {
+    while (!this->quit && this->generation == seen) {
+      this->wake.wait(l);
+    }
+    if (this->quit) {
+      return;
+    }
+    seen = this->generation;
+
+    l.unlock();
+    this->job(this->ctx, worker, this->count);
+    l.lock();
+
+    if (--this->busy == 0) {
+      this->done.notify_one();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include <Arduino.h>
+
+#ifndef __WORKERPOOL_H
+#define __WORKERPOOL_H
+
+#ifdef STRIPGROUP_THREADS
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * A fixed set of threads for StripGroup to spread work over, for host
+ * builds (cf. STRIPGROUP_THREADS). The threads are started once and then
+ * wait; run() wakes them all with the same job, does a share of the work
+ * itself on the calling thread, and returns only once every share is done
+ * (so it doubles as the barrier before show()).
+ *
+ * The job is called as job(ctx, worker, numWorkers) once per worker, with
+ * worker 0 being the caller. It's up to the job to divide the work by
+ * worker number.
+ */
+
+#define MAX_WORKERS 32
+
+class WorkerPool {
+ public:
+  typedef void (*job_t)(void *ctx, uint8_t worker, uint8_t numWorkers);
+
+  WorkerPool(uint8_t numWorkers);
+  ~WorkerPool();
+
+  uint8_t numWorkers();
+  void run(job_t job, void *ctx);
+
+ private:
+  void workerLoop(uint8_t worker);
+
+ private:
+  std::thread *threads;
+  uint8_t count;
+
+  std::mutex lock;
+  std::condition_variable wake;  // a new job (or quit) for the workers
+  std::condition_variable done;  // the last worker finished its share
+  unsigned long generation;      // bumped for every job
+  uint8_t busy;                  // workers still running the current job
+  bool quit;
+
+  job_t job;
+  void *ctx;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * A stand-in for Adafruit_NeoPixel that keeps the pixel buffer exactly the
+ * way the real library does (G,R,B order, scaled by the brightness setting)
+ * but sends it nowhere: show() only counts the frame and moves the virtual 
+ * clock on by as long as the real strip would take (cf. host.h).
+ */
+
+#ifndef __HOST_ADAFRUIT_NEOPIXEL_H
+#define __HOST_ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type);
+  ~Adafruit_NeoPixel();
+
+  void begin();
+  void show();
+  void clear();
+  void setBrightness(uint8_t b);
+  uint8_t getBrightness() const;
+  void setPixelColor(uint16_t n, uint32_t c);
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  uint32_t getPixelColor(uint16_t n) const;
+  uint16_t numPixels() const;
+  uint8_t *getPixels() const;
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b);
+
+ private:
+  uint16_t numLEDs;
+  uint8_t *pixels;
+  uint8_t brightness; // as the library keeps it: setting + 1, 0 = full
+};
+
+#endif
@@ -0,0 +1,2 @@
+// The sketch includes it with both spellings
+#include "Adafruit_NeoPixel.h"
@@ -0,0 +1,62 @@
+/*
+ * Just enough of the Arduino core for the light engine to build and run on
+ * a host (cf. host/README). Time comes from a virtual clock that only moves 
+ * when the harness (or a show()) moves it; see host.h.
+ */
+
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+template<class T> T min(T a, T b) { return (a < b) ? a : b; }
+template<class T> T max(T a, T b) { return (a > b) ? a : b; }
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len);
+  size_t print(const char *s);
+  size_t println(const char *s);
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+// The sketch's serial port. What arrives on it comes from the simulated
+// sender in host.h; what the sketch writes goes back to that sender.
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  size_t write(uint8_t c);
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
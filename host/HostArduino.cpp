@@ -0,0 +1,494 @@
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <RingBuffer.h>
+#include "host.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <deque>
+#include <vector>
+
+static void serialRun(unsigned long long until);
+
+/* The virtual clock */
+
+static unsigned long long nowMicros = 0;
+
+unsigned long hostShowMicrosPerPixel = 30;
+unsigned long hostShowCount = 0;
+Adafruit_NeoPixel *hostLastStrip = NULL;
+
+void hostSetMicros(unsigned long long us)
+{
+  nowMicros = us;
+}
+
+void hostAdvanceMicros(unsigned long long us)
+{
+  nowMicros += us;
+  serialRun(nowMicros);
+}
+
+unsigned long long hostMicros()
+{
+  return nowMicros;
+}
+
+double hostWallSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+unsigned long millis()
+{
+  return nowMicros / 1000;
+}
+
+unsigned long micros()
+{
+  return nowMicros;
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvanceMicros(ms * 1000ULL);
+}
+
+/* random() the way the AVR core does it, so runs are repeatable */
+
+long random(long howbig)
+{
+  if (howbig == 0) {
+    return 0;
+  }
+  return ::random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0) {
+    srandom(seed);
+  }
+}
+
+/* Print */
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+  size_t n = 0;
+  while (len--) {
+    n += write(*buf++);
+  }
+  return n;
+}
+
+size_t Print::print(const char *s)
+{
+  return write((const uint8_t *)s, strlen(s));
+}
+
+size_t Print::println(const char *s)
+{
+  size_t n = print(s);
+  return n + write((const uint8_t *)"\r\n", 2);
+}
+
+/* Serial, and the host on the other end of it */
+
+HardwareSerial Serial;
+
+unsigned long hostSerialBaud = 115200;
+unsigned long hostSerialLatencyMicros = 1000;
+bool hostSerialCredit = false;
+bool hostShowMasksInterrupts = false;
+unsigned long hostSerialLost = 0;
+unsigned long hostSerialOverheadLost = 0;
+
+struct _Grant {
+  unsigned long long when; // ns, when the host has heard it
+  uint8_t credit;
+};
+
+struct _WireByte {
+  uint8_t b;
+  bool data;               // not ENQ or a length byte
+};
+
+static std::deque<uint8_t> toSend;          // queued in the host
+static std::deque<struct _WireByte> line;   // committed to the wire
+static std::deque<uint8_t> rxBuffer;        // the UART's receive buffer
+static std::deque<struct _Grant> grants;    // credit on its way to the host
+static std::vector<uint8_t> written;        // everything the sketch wrote
+static bool sawAck = false;
+static bool asked = false;                  // ENQ sent, and no grant yet
+static unsigned long long askedAt = 0;      // ns
+static unsigned long long lineFree = 0;     // when the next byte can start (ns)
+static unsigned long long maskStart = 0, maskEnd = 0;
+static uint8_t uartFifo = 0;                // bytes held while masked
+
+void hostSerialReset()
+{
+  toSend.clear();
+  line.clear();
+  rxBuffer.clear();
+  grants.clear();
+  written.clear();
+  sawAck = false;
+  asked = false;
+  lineFree = nowMicros * 1000;
+  hostSerialLost = 0;
+  hostSerialOverheadLost = 0;
+}
+
+void hostSerialSend(const uint8_t *data, size_t len)
+{
+  if (toSend.empty() && line.empty() && lineFree < nowMicros * 1000) {
+    lineFree = nowMicros * 1000;
+  }
+  toSend.insert(toSend.end(), data, data + len);
+}
+
+size_t hostSerialPending()
+{
+  return toSend.size() + line.size();
+}
+
+size_t hostSerialWritten(const uint8_t **data)
+{
+  *data = written.data();
+  return written.size();
+}
+
+static void receive(unsigned long long when, struct _WireByte w)
+{
+  bool lost;
+  if (when > maskStart && when <= maskEnd) {
+    // Interrupts are off: the UART's two-byte FIFO is all there is
+    lost = (uartFifo >= 2 || rxBuffer.size() >= SERIAL_RX_BUFFER_SIZE);
+    if (!lost) {
+      uartFifo++;
+    }
+  } else {
+    lost = (rxBuffer.size() >= SERIAL_RX_BUFFER_SIZE);
+  }
+  if (!lost) {
+    rxBuffer.push_back(w.b);
+  } else if (w.data) {
+    hostSerialLost++;
+  } else {
+    hostSerialOverheadLost++;
+  }
+}
+
+static void queue(uint8_t b, bool data)
+{
+  struct _WireByte w = { b, data };
+  line.push_back(w);
+}
+
+// What the host puts on the wire next, deciding at lineFree. False if it
+// has nothing to do until `until` (or later).
+static bool hostNext(unsigned long long until)
+{
+  if (!hostSerialCredit) {
+    // Everything, as fast as the line goes
+    while (!toSend.empty()) {
+      queue(toSend.front(), true);
+      toSend.pop_front();
+    }
+    return !line.empty();
+  }
+
+  // Credit that's reached us gets a reply: as much as we have, up to it
+  if (!grants.empty() && grants.front().when <= lineFree) {
+    size_t n = min((size_t)grants.front().credit, toSend.size());
+    grants.pop_front();
+    asked = false;
+    queue(0x80 | n, false);
+    while (n--) {
+      queue(toSend.front(), true);
+      toSend.pop_front();
+    }
+    return true;
+  }
+
+  // Ask for credit, and ask again if nothing comes back (the ENQ may have
+  // arrived during a show)
+  unsigned long long retry = askedAt +
+    (2ULL * hostSerialLatencyMicros + 10000) * 1000;
+  if (!toSend.empty() && grants.empty() && (!asked || lineFree >= retry)) {
+    queue(0x05, false);
+    asked = true;
+    askedAt = lineFree;
+    return true;
+  }
+
+  // Otherwise wait for whichever comes first
+  unsigned long long next = until;
+  if (!grants.empty()) {
+    next = min(next, grants.front().when);
+  } else if (asked && !toSend.empty()) {
+    next = min(next, retry);
+  }
+  if (next >= until) {
+    return false;
+  }
+  lineFree = next;
+  return true;
+}
+
+// Put everything on the wire that finishes arriving by `until` (in us; 
+// the wire itself runs in ns, since a byte isn't a whole number of us)
+static void serialRun(unsigned long long until)
+{
+  unsigned long long byteNanos = 10000000000ULL / hostSerialBaud;
+  until *= 1000;
+
+  while (1) {
+    if (line.empty() && !hostNext(until)) {
+      break;
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if (lineFree + byteNanos > until) {
+      return;
+    }
+    lineFree += byteNanos;
+    receive(lineFree / 1000, line.front());
+    line.pop_front();
+  }
+  if (lineFree < until) {
+    lineFree = until;
+  }
+}
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+int HardwareSerial::available()
+{
+  return rxBuffer.size();
+}
+
+int HardwareSerial::read()
+{
+  if (rxBuffer.empty()) {
+    return -1;
+  }
+  uint8_t b = rxBuffer.front();
+  rxBuffer.pop_front();
+  return b;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  written.push_back(c);
+  // A credit-aware host takes ACK and the byte after it as a grant, 
+  // whether the sketch meant it that way or not
+  if (sawAck) {
+    struct _Grant g = { (nowMicros + hostSerialLatencyMicros) * 1000, c };
+    grants.push_back(g);
+    sawAck = false;
+  } else if (c == 0x06) {
+    sawAck = true;
+  }
+  return 1;
+}
+
+/* Adafruit_NeoPixel, with the library's buffer layout and brightness math */
+
+#define ROFFSET 1
+#define GOFFSET 0
+#define BOFFSET 2
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t, uint16_t)
+{
+  this->numLEDs = n;
+  this->pixels = (uint8_t *)calloc(n, 3);
+  this->brightness = 0;
+  hostLastStrip = this;
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel()
+{
+  free(this->pixels);
+  if (hostLastStrip == this) {
+    hostLastStrip = NULL;
+  }
+}
+
+void Adafruit_NeoPixel::begin()
+{
+}
+
+void Adafruit_NeoPixel::show()
+{
+  unsigned long long duration = 
+    (unsigned long long)hostShowMicrosPerPixel * this->numLEDs;
+
+  hostShowCount++;
+  if (hostShowMasksInterrupts) {
+    maskStart = nowMicros;
+    maskEnd = nowMicros + duration;
+    uartFifo = 0;
+  }
+  hostAdvanceMicros(duration);
+  maskStart = maskEnd = 0;
+  uartFifo = 0;
+}
+
+void Adafruit_NeoPixel::clear()
+{
+  memset(this->pixels, 0, this->numLEDs * 3);
+}
+
+void Adafruit_NeoPixel::setBrightness(uint8_t b)
+{
+  // Rescale what's already in the buffer, as the library does
+  uint8_t newBrightness = b + 1;
+  if (newBrightness != this->brightness) {
+    uint8_t oldBrightness = this->brightness - 1;
+    uint16_t scale;
+    if (oldBrightness == 0) {
+      scale = 0;
+    } else if (b == 255) {
+      scale = 65535 / oldBrightness;
+    } else {
+      scale = (((uint16_t)newBrightness << 8) - 1) / oldBrightness;
+    }
+    for (uint32_t i=0; i<this->numLEDs * 3; i++) {
+      this->pixels[i] = (this->pixels[i] * scale) >> 8;
+    }
+    this->brightness = newBrightness;
+  }
+}
+
+uint8_t Adafruit_NeoPixel::getBrightness() const
+{
+  return this->brightness - 1;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b)
+{
+  if (n < this->numLEDs) {
+    if (this->brightness) {
+      r = (r * this->brightness) >> 8;
+      g = (g * this->brightness) >> 8;
+      b = (b * this->brightness) >> 8;
+    }
+    uint8_t *p = &this->pixels[n * 3];
+    p[ROFFSET] = r;
+    p[GOFFSET] = g;
+    p[BOFFSET] = b;
+  }
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c)
+{
+  setPixelColor(n, (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const
+{
+  if (n >= this->numLEDs) {
+    return 0;
+  }
+  const uint8_t *p = &this->pixels[n * 3];
+  if (this->brightness) {
+    return (((uint32_t)(p[ROFFSET] << 8) / this->brightness) << 16) |
+      (((uint32_t)(p[GOFFSET] << 8) / this->brightness) << 8) |
+      ((uint32_t)(p[BOFFSET] << 8) / this->brightness);
+  }
+  return ((uint32_t)p[ROFFSET] << 16) | ((uint32_t)p[GOFFSET] << 8) | p[BOFFSET];
+}
+
+uint16_t Adafruit_NeoPixel::numPixels() const
+{
+  return this->numLEDs;
+}
+
+uint8_t *Adafruit_NeoPixel::getPixels() const
+{
+  return this->pixels;
+}
+
+uint32_t Adafruit_NeoPixel::Color(uint8_t r, uint8_t g, uint8_t b)
+{
+  return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+/* RingBuffer */
+
+RingBuffer::RingBuffer(int16_t length)
+{
+  this->buffer = (uint8_t *)malloc(length);
+  this->max = length;
+  this->ptr = 0;
+  this->fill = 0;
+}
+
+RingBuffer::~RingBuffer()
+{
+  free(this->buffer);
+}
+
+void RingBuffer::clear()
+{
+  this->ptr = this->fill = 0;
+}
+
+bool RingBuffer::isFull()
+{
+  return (this->fill == this->max);
+}
+
+bool RingBuffer::hasData()
+{
+  return (this->fill != 0);
+}
+
+bool RingBuffer::addByte(uint8_t b)
+{
+  if (isFull()) {
+    return false;
+  }
+  this->buffer[(this->ptr + this->fill) % this->max] = b;
+  this->fill++;
+  return true;
+}
+
+uint8_t RingBuffer::consumeByte()
+{
+  if (this->fill == 0) {
+    return 0;
+  }
+  uint8_t b = this->buffer[this->ptr];
+  this->ptr = (this->ptr + 1) % this->max;
+  this->fill--;
+  return b;
+}
+
+uint8_t RingBuffer::peek(int16_t idx)
+{
+  if (idx >= this->fill) {
+    return 0;
+  }
+  return this->buffer[(this->ptr + idx) % this->max];
+}
+
+int16_t RingBuffer::count()
+{
+  return this->fill;
+}
@@ -0,0 +1,95 @@
+/*
+ * Reads a FrameTrace stream back (see ../FrameTrace.h), one frame at a 
+ * time, keeping the whole current frame as the strips had it: G,R,B bytes
+ * with brightness applied.
+ */
+
+#ifndef __TRACEREADER_H
+#define __TRACEREADER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class TraceReader {
+ public:
+  TraceReader(FILE *f) {
+    this->f = f;
+    this->numPixels = 0;
+    this->frame = NULL;
+    this->millis = 0;
+    this->first = this->count = 0;
+    this->frames = 0;
+    this->ok = false;
+
+    uint8_t magic[4];
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, "BFT", 3) != 0) {
+      fprintf(stderr, "not a frame trace\n");
+      return;
+    }
+    if (magic[3] != 2) {
+      fprintf(stderr, "frame trace version %u; only 2 is supported\n", magic[3]);
+      return;
+    }
+    if (!read32(&this->numPixels)) {
+      return;
+    }
+    this->frame = (uint8_t *)calloc(this->numPixels, 3);
+    this->ok = (this->frame != NULL);
+  }
+
+  ~TraceReader() {
+    free(this->frame);
+  }
+
+  // Apply the next record to frame[]; false at the end of the trace (or 
+  // at a truncated record)
+  bool next() {
+    if (!this->ok || !read32(&this->millis)) {
+      return false;
+    }
+    if (!read32(&this->first) || !read32(&this->count) ||
+	this->first > this->numPixels ||
+	this->count > this->numPixels - this->first) {
+      this->ok = false;
+      return false;
+    }
+    if (fread(&this->frame[this->first * 3], 3, this->count, this->f) != this->count) {
+      this->ok = false;
+      return false;
+    }
+    this->frames++;
+    return true;
+  }
+
+  // Pixel n of the current frame, as 0xRRGGBB
+  uint32_t pixel(uint32_t n) {
+    const uint8_t *p = &this->frame[n * 3];
+    return ((uint32_t)p[1] << 16) | ((uint32_t)p[0] << 8) | p[2];
+  }
+
+ private:
+  bool read32(uint32_t *v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, this->f) != 4) {
+      return false;
+    }
+    *v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+  }
+
+ public:
+  bool ok;             // the header was good, and no record was truncated
+  uint32_t numPixels;
+  uint8_t *frame;      // numPixels * G,R,B
+  uint32_t millis;     // of the current frame
+  uint32_t first;      // the run of pixels its record changed
+  uint32_t count;
+  unsigned long frames;
+
+ private:
+  FILE *f;
+};
+
+#endif
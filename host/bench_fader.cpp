@@ -0,0 +1,75 @@
+/*
+ * The two Fader8bit backends head to head, on StripGroups of 10k to 100k
+ * pixels: this is built twice, as bench_fader (the packed backend) and 
+ * bench_fader_soa (FADER8BIT_SOA). One thread, and show() is free (cf. 
+ * hostShowMicrosPerPixel), so only the fade steps are timed.
+ *
+ * "all" has every pixel fading, as in pulse mode; "1 in 10" has every 
+ * tenth, about as sparse as twinkle. The fades are started outside the 
+ * timing, and then each performFade() steps every chunk once.
+ */
+
+#include <stdio.h>
+#include "host.h"
+#include "../StripGroup.h"
+
+#ifdef FADER8BIT_SOA
+#define BACKEND "soa"
+#else
+#define BACKEND "packed"
+#endif
+
+#define STEPS 40
+
+static const pixelnum_t sizes[] = { 10000, 25000, 50000, 100000 };
+static const uint8_t spacings[] = { 1, 10 };
+
+// ns per fading pixel, per step
+static double nanosPerPixel(pixelnum_t size, uint8_t spacing)
+{
+  StripGroup *g = new StripGroup();
+  for (uint8_t i=0; i<MAX_STRIPS; i++) {
+    g->addStrip(i, size / MAX_STRIPS);
+  }
+  g->setFadeMode(false);
+
+  double elapsed = 0;
+  unsigned long steps = 0;
+  pixelnum_t fading = 0;
+  for (int round=0; round<3; round++) {
+    fading = 0;
+    for (pixelnum_t i=0; i<g->numPixels(); i+=spacing) {
+      g->setFading(i, (i & 1) ? 0xFFFFC4 : 0x4080F0);
+      fading++;
+    }
+    for (int s=0; s<STEPS; s++) {
+      hostSetMicros(g->nextFadeMillis() * 1000ULL);
+      double start = hostWallSeconds();
+      g->performFade();
+      elapsed += hostWallSeconds() - start;
+      steps++;
+    }
+  }
+
+  delete g;
+  return elapsed * 1e9 / steps / fading;
+}
+
+int main()
+{
+  hostShowMicrosPerPixel = 0;
+
+  printf("%-7s %-8s %7s %10s %12s\n", "backend", "fading", "pixels", 
+	 "ns/pixel", "steps/s");
+  for (unsigned f=0; f<sizeof(spacings); f++) {
+    for (unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+      double ns = nanosPerPixel(sizes[s], spacings[f]);
+      pixelnum_t fading = sizes[s] / spacings[f];
+      printf("%-7s %-8s %7lu %10.2f %12.0f\n", BACKEND, 
+	     spacings[f] == 1 ? "all" : "1 in 10", (unsigned long)sizes[s], ns,
+	     1e9 / (ns * fading));
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * What isQuiescent() saves in each mode: the sketch's loop() on 150 LEDs
+ * for 10 seconds of virtual time, spinning flat out ("busy", as before) 
+ * and sleeping whenever the lights are quiescent ("idle", as now).
+ *
+ * Each pass through loop() costs LOOP_MICROS for polling the radio and 
+ * the serial port and update()'s own checks, plus 30us a pixel for each 
+ * show(). Asleep, the CPU is woken by the next millis() tick (every 
+ * millisecond), as SLEEP_MODE_IDLE is in the sketch, and loop() checks 
+ * again. "awake" is the share of virtual time the CPU spent running, and
+ * "host ms" is how long the engine itself took on this machine.
+ */
+
+#include <stdio.h>
+#include "host.h"
+#include "../SimpleStripLights.h"
+
+#define LOOP_MICROS 50
+#define RUN_MICROS 10000000ULL
+#define NUM_LEDS 150
+
+struct _Result {
+  unsigned long passes;
+  unsigned long shows;
+  unsigned long long asleep;  // us
+  double hostSeconds;
+};
+
+static void run(const char *commands, size_t len, bool idle, struct _Result *r)
+{
+  srandom(1);
+  hostSetMicros(0);
+  SimpleStripLights *lights = new SimpleStripLights(1, NUM_LEDS, RawMode, 
+						    0xFF8020, 0x1020FF);
+  lights->handleCommands((const uint8_t *)commands, len);
+
+  r->passes = 0;
+  r->shows = hostShowCount;
+  r->asleep = 0;
+  double start = hostWallSeconds();
+  while (hostMicros() < RUN_MICROS) {
+    hostAdvanceMicros(LOOP_MICROS);
+    lights->update();
+    r->passes++;
+
+    unsigned long wakeAt;
+    if (idle && lights->isQuiescent(&wakeAt)) {
+      unsigned long long tick = (hostMicros() / 1000 + 1) * 1000;
+      r->asleep += tick - hostMicros();
+      hostSetMicros(tick);
+    }
+  }
+  r->hostSeconds = hostWallSeconds() - start;
+  r->shows = hostShowCount - r->shows;
+  delete lights;
+}
+
+int main()
+{
+  static const struct {
+    const char *name;
+    const char *commands;
+    size_t len;
+  } modes[] = {
+    { "raw", "r", 1 },
+    { "color", "C", 1 },
+    { "wipe", "W", 1 },
+    { "chase", "!", 1 },
+    { "twinkle", "T", 1 },
+    { "tardis", "t", 1 },
+    { "pulse", "p", 1 },
+    { "rainbow", "h", 1 },
+    { "sine", "s", 1 },
+    { "plasma", "P", 1 },
+    { "plasma+layer", "PL\x73\x01", 4 },
+  };
+
+  printf("%-13s %17s %17s %9s %8s %17s\n", "", "loops/s", "awake", 
+	 "saved", "frames", "host ms");
+  printf("%-13s %8s %8s %8s %8s %9s %8s %8s %8s\n", "mode", "busy", "idle",
+	 "busy", "idle", "us/s", "", "busy", "idle");
+  for (unsigned m=0; m<sizeof(modes)/sizeof(modes[0]); m++) {
+    struct _Result busy, idle;
+    run(modes[m].commands, modes[m].len, false, &busy);
+    run(modes[m].commands, modes[m].len, true, &idle);
+
+    double seconds = RUN_MICROS / 1e6;
+    printf("%-13s %8.0f %8.0f %7.1f%% %7.1f%% %9.0f %8lu %8.1f %8.1f\n",
+	   modes[m].name, busy.passes / seconds, idle.passes / seconds,
+	   100.0 * (RUN_MICROS - busy.asleep) / RUN_MICROS,
+	   100.0 * (RUN_MICROS - idle.asleep) / RUN_MICROS,
+	   idle.asleep / seconds, idle.shows,
+	   busy.hostSeconds * 1000, idle.hostSeconds * 1000);
+    if (idle.shows != busy.shows) {
+      printf("  (the busy loop showed %lu frames)\n", busy.shows);
+    }
+  }
+  return 0;
+}
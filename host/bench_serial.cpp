@@ -0,0 +1,107 @@
+/*
+ * Serial throughput, and how much of it is lost, streaming raw-mode pixel
+ * writes into the sketch's loop(). Once a byte is lost the stream is out
+ * of step, so the pixel numbers are chosen to be harmless if they're read
+ * as commands, and the loop keeps doing the same work either way.
+ *
+ * "before" is the original loop(): one byte a pass, from a host that just
+ * sends. "now" is SerialInput, holding update() while credit is out, with
+ * a host that speaks its credit protocol. Each pass also spends 
+ * LOOP_MICROS on everything else loop() does (the radio, update()'s own
+ * work), and show() takes 30us a pixel, as it does on the real strip. 
+ * "masked" runs show() with interrupts off, as on an AVR.
+ */
+
+#include <stdio.h>
+#include "host.h"
+#include "../SimpleStripLights.h"
+#include "../SerialInput.h"
+
+#define LOOP_MICROS 500
+#define STREAM_BYTES 30000
+
+// The loop() that SerialInput replaced
+static void pollBefore(SimpleStripLights *lights)
+{
+  if (Serial.available() > 0) {
+    byte b = Serial.read();
+    lights->handleCommands(&b, 1);
+  }
+}
+
+static void run(bool before, uint16_t numLights, unsigned long baud,
+		unsigned long latency, bool masked)
+{
+  hostSetMicros(0);
+  hostSerialReset();
+  hostSerialBaud = baud;
+  hostSerialLatencyMicros = latency;
+  hostShowMasksInterrupts = masked;
+  hostSerialCredit = !before;
+
+  SimpleStripLights *lights = new SimpleStripLights(1, numLights, RawMode);
+  SerialInput input(&Serial, lights);
+
+  // Pixel numbers that no command starts with
+  uint8_t pixels[256];
+  int numPixels = 0;
+  for (int p=0; p<256 && p<numLights; p++) {
+    if (!strchr("!1CFLPRTWbcfhlprstx^", p)) {
+      pixels[numPixels++] = p;
+    }
+  }
+
+  // 'r', then raw-mode pixel writes ('1', pixel number) round the strip
+  static uint8_t stream[STREAM_BYTES];
+  memset(stream, 0, sizeof(stream));
+  stream[0] = 'r';
+  for (int i=1; i+2<STREAM_BYTES; i+=3) {
+    stream[i] = '1';
+    stream[i+1] = 0;
+    stream[i+2] = pixels[(i / 3) % numPixels];
+  }
+  hostSerialSend(stream, STREAM_BYTES);
+
+  unsigned long shows = hostShowCount;
+  while (hostSerialPending() || Serial.available()) {
+    if (before) {
+      pollBefore(lights);
+    } else {
+      input.poll();
+      if (input.isReceiving()) {
+	hostAdvanceMicros(LOOP_MICROS);
+	continue;
+      }
+    }
+    lights->update();
+    hostAdvanceMicros(LOOP_MICROS);
+  }
+  double seconds = hostMicros() / 1e6;
+
+  printf("%-7s %5u %7lu %6.1fms %-6s %7.0f B/s %5.0f%%  %6lu lost  %4lu ctl lost  %5lu frames\n",
+	 before ? "before" : "now", numLights, baud, latency / 1000.0,
+	 masked ? "masked" : "open", (STREAM_BYTES - hostSerialLost) / seconds,
+	 100.0 * (STREAM_BYTES - hostSerialLost) / seconds / (hostSerialBaud / 10.0),
+	 hostSerialLost, hostSerialOverheadLost, hostShowCount - shows);
+  delete lights;
+}
+
+int main()
+{
+  printf("%-7s %5s %7s %8s %-6s %11s %6s\n", "loop", "LEDs", "baud", 
+	 "latency", "irqs", "throughput", "line");
+  const uint16_t sizes[] = { 150, 300 };
+  const unsigned long bauds[] = { 115200, 57600 };
+  const unsigned long latencies[] = { 1000, 16000 };
+  for (int masked=0; masked<2; masked++) {
+    for (unsigned s=0; s<2; s++) {
+      for (unsigned b=0; b<2; b++) {
+	for (unsigned l=0; l<2; l++) {
+	  run(true, sizes[s], bauds[b], latencies[l], masked);
+	  run(false, sizes[s], bauds[b], latencies[l], masked);
+	}
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Frames per second against worker threads, for big StripGroups.
+ *
+ * Each size is split over MAX_STRIPS strips. show() is free here (cf. 
+ * hostShowMicrosPerPixel) so that only the engine is timed: the procedural
+ * modes (which render every pixel every frame), pulse (which keeps every
+ * pixel fading) and plasma with two layers on top.
+ */
+
+#include <stdio.h>
+#include "host.h"
+#include "../SimpleStripLights.h"
+
+static const pixelnum_t sizes[] = { 10000, 25000, 50000, 100000 };
+static const uint8_t threads[] = { 1, 2, 4, 8 };
+
+struct _Case {
+  const char *name;
+  const char *commands;
+};
+
+static const struct _Case cases[] = {
+  { "rainbow", "h" },
+  { "plasma", "P" },
+  { "pulse", "p" },
+  { "plasma+2 layers", "PL\x73\x01L\x54\x02" },
+};
+
+static double framesPerSecond(pixelnum_t size, uint8_t numThreads, 
+			      const char *commands)
+{
+  StripGroup *g = new StripGroup();
+  for (uint8_t i=0; i<MAX_STRIPS; i++) {
+    g->addStrip(i, size / MAX_STRIPS);
+  }
+  g->setWorkerThreads(numThreads);
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  lights->handleCommands((const uint8_t *)commands, strlen(commands));
+
+  // Let it settle, then time a virtual second's worth of updates
+  for (int i=0; i<50; i++) {
+    hostAdvanceMicros(10000);
+    lights->update();
+  }
+  unsigned long shows = hostShowCount;
+  double start = hostWallSeconds();
+  for (int i=0; i<100; i++) {
+    hostAdvanceMicros(10000);
+    lights->update();
+  }
+  double elapsed = hostWallSeconds() - start;
+  unsigned long frames = (hostShowCount - shows) / MAX_STRIPS;
+
+  delete lights;
+  return frames / elapsed;
+}
+
+int main()
+{
+  hostShowMicrosPerPixel = 0;
+
+  printf("%-16s %7s", "mode", "pixels");
+  for (unsigned t=0; t<sizeof(threads); t++) {
+    printf("  %2u thr", threads[t]);
+  }
+  printf("   (fps)\n");
+
+  for (unsigned c=0; c<sizeof(cases)/sizeof(cases[0]); c++) {
+    for (unsigned s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+      printf("%-16s %7lu", cases[c].name, (unsigned long)sizes[s]);
+      for (unsigned t=0; t<sizeof(threads); t++) {
+	printf("  %6.0f", framesPerSecond(sizes[s], threads[t], cases[c].commands));
+	fflush(stdout);
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Hooks for the host harness: the virtual clock, and what show() costs.
+ */
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#include <Arduino.h>
+#include <stdio.h>
+
+// The virtual clock that millis() and micros() read. Nothing moves it but
+// these calls, delay() and show().
+void hostSetMicros(unsigned long long us);
+void hostAdvanceMicros(unsigned long long us);
+unsigned long long hostMicros();
+
+// How long show() takes per pixel (30us for WS2812s: 24 bits at 800kHz).
+// 0 makes show() free, for benchmarks that only want to time the engine.
+extern unsigned long hostShowMicrosPerPixel;
+// How many times show() has been called, on any strip
+extern unsigned long hostShowCount;
+
+// The newest Adafruit_NeoPixel that's still around (NULL if none)
+class Adafruit_NeoPixel;
+extern Adafruit_NeoPixel *hostLastStrip;
+
+// The host on the other end of Serial. It sends what's queued with 
+// hostSerialSend() at hostSerialBaud (10 bits a byte) into the UART's 
+// SERIAL_RX_BUFFER_SIZE-byte receive buffer. Bytes that arrive to a full
+// buffer are lost, and counted.
+//
+// A plain host sends everything straight away. With hostSerialCredit, it
+// follows SerialInput's credit protocol instead: it sends ENQ when it has
+// something (and again if no credit comes), and answers each ACK <n> the
+// sketch writes, hostSerialLatencyMicros later (USB serial adapters batch
+// and delay in both directions), with <0x80 | L> and L bytes. 
+// hostSerialOverheadLost counts the ENQs and length bytes that were lost.
+//
+// With hostShowMasksInterrupts, show() runs with interrupts off, as the 
+// AVR version of Adafruit_NeoPixel does: the UART itself holds two bytes,
+// and anything more that arrives during the show is lost.
+extern unsigned long hostSerialBaud;
+extern unsigned long hostSerialLatencyMicros;
+extern bool hostSerialCredit;
+extern bool hostShowMasksInterrupts;
+extern unsigned long hostSerialLost;
+extern unsigned long hostSerialOverheadLost;
+void hostSerialSend(const uint8_t *data, size_t len);
+size_t hostSerialPending();
+void hostSerialReset();
+// Everything the sketch has written to Serial
+size_t hostSerialWritten(const uint8_t **data);
+
+// A Print that writes to a file, for FrameTrace
+class HostFilePrint : public Print {
+ public:
+  HostFilePrint(FILE *f) { this->f = f; }
+  size_t write(uint8_t c) { return fputc(c, this->f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buf, size_t len) { return fwrite(buf, 1, len, this->f); }
+ private:
+  FILE *f;
+};
+
+// Wall-clock time, for benchmarks
+double hostWallSeconds();
+
+#endif
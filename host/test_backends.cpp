@@ -0,0 +1,144 @@
+/*
+ * The packed and the FADER8BIT_SOA Fader8bit backends have to show the
+ * same frames, dimmed or not. They can't both be linked into one program,
+ * so this is built both ways (test_backends, test_backends_soa): the
+ * packed build runs each case itself, runs the SoA build to trace the
+ * same case to a pipe, and compares the two traces frame by frame.
+ */
+
+#include <stdio.h>
+#include <string>
+#include "host.h"
+#include "TraceReader.h"
+#include "../SimpleStripLights.h"
+
+struct _Case {
+  const char *name;
+  const char *commands;   // sent first
+  size_t len;
+  const char *later;      // and halfway through
+  size_t laterLen;
+};
+
+#define CMD(s) s, sizeof(s) - 1
+
+static const struct _Case cases[] = {
+  { "twinkle", CMD("T"), CMD("") },
+  { "pulse", CMD("p"), CMD("") },
+  { "wipe", CMD("W"), CMD("") },
+  { "dim pulse", CMD("b\x80p"), CMD("") },
+  { "dim twinkle", CMD("b\x80T"), CMD("") },
+  { "dim wipe", CMD("b\x60W"), CMD("") },
+  { "pulse set up dim, shown bright", CMD("b\x40pb\xff"), CMD("") },
+  { "twinkle, dimmed halfway", CMD("c\xff\x40\x10T"), CMD("b\x30") },
+  { "dim pulse, brightened halfway", CMD("b\x50p"), CMD("b\xff") },
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+// Run one case on two strips (three faders), tracing it to f
+static void record(const struct _Case *c, FILE *f)
+{
+  HostFilePrint out(f);
+
+  srandom(1);
+  hostSetMicros(0);
+  StripGroup *g = new StripGroup();
+  g->addStrip(1, 300);
+  g->addStrip(2, 90);
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  FrameTrace *trace = new FrameTrace(&out, g->numPixels());
+  lights->setFrameTrace(trace);
+
+  lights->handleCommands((const uint8_t *)c->commands, c->len);
+  for (int i=0; i<4000; i++) {
+    if (i == 2000 && c->laterLen) {
+      lights->handleCommands((const uint8_t *)c->later, c->laterLen);
+    }
+    lights->update();
+    hostAdvanceMicros(1000);
+  }
+  fflush(f);
+
+  lights->setFrameTrace(NULL);
+  delete trace;
+  delete lights;
+}
+
+#ifndef FADER8BIT_SOA
+static int compare(const char *soa, unsigned n)
+{
+  const struct _Case *c = &cases[n];
+
+  char command[1024];
+  snprintf(command, sizeof(command), "%s %u", soa, n);
+  FILE *mine = tmpfile();
+  FILE *theirs = popen(command, "r");
+  if (!mine || !theirs) {
+    printf("FAIL: %s: can't run %s\n", c->name, command);
+    return 1;
+  }
+  record(c, mine);
+  rewind(mine);
+
+  int failures = 0;
+  TraceReader a(mine), b(theirs);
+  if (!a.ok || !b.ok || a.numPixels != b.numPixels) {
+    printf("FAIL: %s: bad trace\n", c->name);
+    failures++;
+  }
+  while (!failures) {
+    bool moreA = a.next(), moreB = b.next();
+    if (moreA != moreB) {
+      printf("FAIL: %s: %lu frames packed, %lu SoA\n", c->name,
+	     a.frames, b.frames);
+      failures++;
+    } else if (!moreA) {
+      break;
+    } else if (a.millis != b.millis ||
+	       memcmp(a.frame, b.frame, a.numPixels * 3) != 0) {
+      uint32_t p = 0;
+      while (p < a.numPixels && a.pixel(p) == b.pixel(p)) {
+	p++;
+      }
+      printf("FAIL: %s: frame %lu (%u ms), pixel %u: packed %06X, SoA %06X\n",
+	     c->name, a.frames, a.millis, p,
+	     p < a.numPixels ? a.pixel(p) : 0,
+	     p < a.numPixels ? b.pixel(p) : 0);
+      failures++;
+    }
+  }
+  if (!failures && a.frames < 100) {
+    printf("FAIL: %s: only %lu frames\n", c->name, a.frames);
+    failures++;
+  }
+
+  pclose(theirs);
+  fclose(mine);
+  return failures;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+#ifdef FADER8BIT_SOA
+  // Trace one case to stdout, for the packed build to compare with
+  unsigned n = (argc == 2) ? atoi(argv[1]) : NUM_CASES;
+  if (n >= NUM_CASES) {
+    fprintf(stderr, "usage: %s <case>\n", argv[0]);
+    return 2;
+  }
+  record(&cases[n], stdout);
+  return 0;
+#else
+  (void)argc;
+  std::string soa = std::string(argv[0]) + "_soa";
+  int failures = 0;
+
+  for (unsigned n=0; n<NUM_CASES; n++) {
+    failures += compare(soa.c_str(), n);
+  }
+
+  printf("%s\n", failures ? "test_backends: FAILED" : "test_backends: ok");
+  return failures ? 1 : 0;
+#endif
+}
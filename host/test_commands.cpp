@@ -0,0 +1,132 @@
+/*
+ * Coalescing a batch of commands must not change where the lights end up.
+ * Every sequence of up to three modes and settings is run as one batch 
+ * with coalescing on and off, and the frames compared once the fades have
+ * had time to finish.
+ *
+ * Sent separately, each command also gets an update() before the next 
+ * one, which can leave its own mark (a frame drawn before raw mode, a 
+ * fade step before pulse restarts them), so that's only compared for 
+ * sequences where it can't: those where an earlier mode can only have 
+ * been dropped by coalescing.
+ */
+
+#include <stdio.h>
+#include <string>
+#include "host.h"
+#include "../SimpleStripLights.h"
+
+#define END_MILLIS 2500
+
+static const char *tokens[] = { "T", "W", "!", "t", "C", "p", "h", "s", "P",
+				"r", "c\x10\x80\xff", "x\xff\x20\x01", "f\x00",
+				"F\x01", "R\x03", "b\x40", "b\xc0", "1\x00\x05" };
+#define NUM_TOKENS (sizeof(tokens)/sizeof(tokens[0]))
+
+static size_t tokenLength(const char *t)
+{
+  // (settings can have 0 bytes in them)
+  switch (t[0]) {
+  case 'f': case 'F': case 'R': case 'b':
+    return 2;
+  case '1':
+    return 3;
+  case 'c': case 'x':
+    return 4;
+  }
+  return 1;
+}
+
+// The frame after running the given commands, in one batch or separately
+static std::string endFrame(const std::string &commands, bool coalesce, 
+			    bool separately)
+{
+  StripGroup *g = new StripGroup();
+  g->addStrip(1, 60);
+
+  srandom(1);
+  hostSetMicros(0);
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  lights->setCoalescing(coalesce);
+  if (separately) {
+    for (size_t i=0; i<commands.size(); ) {
+      size_t len = tokenLength(&commands[i]);
+      lights->handleCommands((const uint8_t *)&commands[i], len);
+      lights->update();
+      i += len;
+    }
+  } else {
+    lights->handleCommands((const uint8_t *)commands.data(), commands.size());
+    lights->update();
+  }
+  while (millis() < END_MILLIS) {
+    hostAdvanceMicros(10000);
+    lights->update();
+  }
+
+  std::string frame(g->numPixels() * 3, 0);
+  g->saveFrame((uint8_t *)&frame[0]);
+  delete lights;
+  return frame;
+}
+
+static void printCommands(const std::string &commands)
+{
+  for (size_t i=0; i<commands.size(); i++) {
+    uint8_t c = commands[i];
+    if (c >= ' ' && c < 127) {
+      putchar(c);
+    } else {
+      printf("\\x%02x", c);
+    }
+  }
+}
+
+int main()
+{
+  int failures = 0;
+
+  // Separately, commands are shown as they come, and that costs time; 
+  // here it mustn't, so that both ways line up in time.
+  hostShowMicrosPerPixel = 0;
+
+  unsigned long sequences = 0;
+  for (unsigned a=0; a<NUM_TOKENS; a++) {
+    for (unsigned b=0; b<=NUM_TOKENS; b++) {
+      for (unsigned c=0; c<=NUM_TOKENS && failures < 10; c++) {
+	if ((b == NUM_TOKENS && c != NUM_TOKENS)) {
+	  continue;
+	}
+	std::string commands(tokens[a], tokenLength(tokens[a]));
+	if (b < NUM_TOKENS) {
+	  commands.append(tokens[b], tokenLength(tokens[b]));
+	}
+	if (c < NUM_TOKENS) {
+	  commands.append(tokens[c], tokenLength(tokens[c]));
+	}
+	sequences++;
+	if (endFrame(commands, true, false) != endFrame(commands, false, false)) {
+	  printf("FAIL: \"");
+	  printCommands(commands);
+	  printf("\" ends differently when it's coalesced\n");
+	  failures++;
+	}
+      }
+    }
+  }
+
+  static const char *separable[] = { "pC", "pT", "Ch", "Wh", "ps", "tP", 
+				     "TCh", "pCs", "WpP" };
+  for (unsigned i=0; i<sizeof(separable)/sizeof(separable[0]); i++) {
+    std::string commands(separable[i]);
+    if (endFrame(commands, true, false) != endFrame(commands, true, true)) {
+      printf("FAIL: \"%s\" ends differently in one batch and sent separately\n",
+	     separable[i]);
+      failures++;
+    }
+  }
+
+  printf("%s (%lu sequences)\n", 
+	 failures ? "test_commands: FAILED" : "test_commands: ok", sequences);
+  return failures ? 1 : 0;
+}
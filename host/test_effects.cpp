@@ -0,0 +1,148 @@
+/*
+ * blendColor() has to get the same answer as the plain lerp 
+ * a + (b - a) * amount / 256 (rounded down), for every pair of channel 
+ * values and every amount, without needing more than 16 bits on the way
+ * (an AVR's int). sin8() has to be a sine wave, and the effects have to
+ * draw what they did when they were written, on any pixel number a host 
+ * can have. And layers only take the effects and blendops there are.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "host.h"
+#include "../ProceduralEffects.h"
+#include "../SimpleStripLights.h"
+
+// Floor division, as the arithmetic shift would do it
+static int32_t lerp(int32_t a, int32_t b, int32_t amount)
+{
+  int32_t d = (b - a) * amount;
+  return a + (d >= 0 ? d / 256 : -((-d + 255) / 256));
+}
+
+static int expectColor(const char *what, uint32_t got, uint32_t want)
+{
+  if (got != want) {
+    printf("FAIL: %s: got %06x, want %06x\n", what, (unsigned)got, (unsigned)want);
+    return 1;
+  }
+  return 0;
+}
+
+static int sineChecks()
+{
+  int failures = 0;
+
+  if (sin8(0) != 128 || sin8(64) != 255 || sin8(128) != 128 || sin8(192) != 1) {
+    printf("FAIL: sin8 at 0, 64, 128, 192: %u %u %u %u\n", 
+	   sin8(0), sin8(64), sin8(128), sin8(192));
+    failures++;
+  }
+  for (int t=0; t<256; t++) {
+    double want = 128 + 127 * sin(2 * M_PI * t / 256);
+    if (fabs(sin8(t) - want) > 1) {
+      printf("FAIL: sin8(%d) is %u, want %.1f\n", t, sin8(t), want);
+      failures++;
+    }
+    // Symmetric about the peak, and the second half mirrors the first
+    if (t <= 64 && sin8(64 + t) != sin8(64 - t)) {
+      printf("FAIL: sin8(64 + %d) != sin8(64 - %d)\n", t, t);
+      failures++;
+    }
+    if (t < 128 && sin8(t) + sin8(t + 128) != 256) {
+      printf("FAIL: sin8(%d) and sin8(%d) don't add up to 256\n", t, t + 128);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+static int effectChecks()
+{
+  int failures = 0;
+  struct _EffectParams p;
+
+  // Worked out by hand from the quarter-sine table
+  p.phase = 0;
+  p.color = 0xFFFFFF;
+  p.color2 = 0x000000;
+  failures += expectColor("rainbow, pixel 0", RainbowEffect::render(0, p), 0x80EF13);
+  failures += expectColor("rainbow, pixel 16", RainbowEffect::render(16, p), 0xFF413F);
+  failures += expectColor("sine, pixel 0", SineEffect::render(0, p), 0x7F7F7F);
+  failures += expectColor("sine, peak", SineEffect::render(8, p), 0xFEFEFE);
+  failures += expectColor("sine, trough", SineEffect::render(24, p), 0x000000);
+  p.phase = 32;
+  failures += expectColor("sine, moved on", SineEffect::render(12, p), 0xFEFEFE);
+
+  p.phase = 0;
+  p.color = 0xFF0000;
+  p.color2 = 0x0000FF;
+  failures += expectColor("plasma, pixel 0", PlasmaEffect::render(0, p), 0x7F007F);
+  failures += expectColor("plasma, pixel 1", PlasmaEffect::render(1, p), 0x980066);
+  failures += expectColor("breathe, phase 0", BreatheEffect::render(5, p), 0x7F0000);
+
+  // Past 65535 the pixel number mustn't wrap around: sparkles on a long
+  // strip don't repeat themselves (where pixelnum_t has the bits for it)
+  if (sizeof(pixelnum_t) > 2) {
+    // (Most pixels are dark most of the time, so about half match anyway)
+    long same = 0, total = 0;
+    p.color2 = 0x00FF00;
+    for (uint8_t phase=0; phase<250; phase += 5) {
+      p.phase = phase;
+      for (pixelnum_t i=0; i<4096; i++) {
+	same += (SparkleEffect::render(i, p) == SparkleEffect::render(i + 65536, p));
+	total++;
+      }
+    }
+    if (same > total * 3 / 4) {
+      printf("FAIL: sparkle repeats itself every 65536 pixels\n");
+      failures++;
+    }
+  }
+  return failures;
+}
+
+int main()
+{
+  int failures = 0;
+
+  for (int32_t a=0; a<256 && failures < 10; a++) {
+    for (int32_t b=0; b<256; b++) {
+      for (int32_t amount=0; amount<256; amount++) {
+	int32_t want = lerp(a, b, amount);
+	uint32_t c1 = (a << 16) | (b << 8) | a;
+	uint32_t c2 = (b << 16) | (a << 8) | b;
+	uint32_t got = blendColor(c1, c2, amount);
+	if (((got >> 16) & 0xFF) != (uint32_t)want || 
+	    ((got >> 8) & 0xFF) != (uint32_t)lerp(b, a, amount) ||
+	    (got & 0xFF) != (uint32_t)want) {
+	  printf("FAIL: blend %d to %d by %d: got %06x, want %d\n",
+		 a, b, amount, (unsigned)got, want);
+	  failures++;
+	}
+
+	if (a * (256 - amount) + b * amount > 0xFFFF) {
+	  printf("FAIL: blend %d to %d by %d needs more than 16 bits\n",
+		 a, b, amount);
+	  failures++;
+	}
+      }
+    }
+  }
+
+  failures += sineChecks();
+  failures += effectChecks();
+
+  SimpleStripLights *lights = new SimpleStripLights(1, 10, RawMode);
+  if (!lights->pushLayer(PlasmaEffect::opcode, BlendMax) ||
+      lights->pushLayer(PlasmaEffect::opcode, BlendMax + 1) ||
+      lights->pushLayer(PlasmaEffect::opcode, 0xFF) ||
+      lights->pushLayer('Z', BlendReplace)) {
+    printf("FAIL: pushLayer() took a bad blendop or effect, or not a good one\n");
+    failures++;
+  }
+  delete lights;
+
+  printf("%s\n", failures ? "test_effects: FAILED" : "test_effects: ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * A FrameTrace has to carry exactly what the strips were shown: replay 
+ * each trace and compare every frame with the strips' own buffers, with 
+ * the brightness turned down (where reading colors back would lose bits) 
+ * and across more pixels than 16 bits can number. And each record has to
+ * carry only the run of pixels that changed, however many strips it spans.
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "host.h"
+#include "TraceReader.h"
+#include "../SimpleStripLights.h"
+
+// A Print that keeps everything, and counts the bytes
+class BufferPrint : public Print {
+ public:
+  size_t write(uint8_t c) { data.push_back(c); return 1; }
+  std::vector<uint8_t> data;
+};
+
+static int run(const char *name, uint16_t strip1, uint16_t strip2, 
+	       const char *commands, size_t len, int steps)
+{
+  int failures = 0;
+
+  StripGroup *g = new StripGroup();
+  g->addStrip(1, strip1);
+  g->addStrip(2, strip2);
+  size_t frameBytes = g->numPixels() * 3;
+
+  srandom(1);
+  hostSetMicros(0);
+  BufferPrint out;
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  FrameTrace *trace = new FrameTrace(&out, g->numPixels());
+  lights->setFrameTrace(trace);
+
+  // What the strips held after each update() that recorded a frame
+  std::vector<uint8_t> shown;
+  lights->handleCommands((const uint8_t *)commands, len);
+  for (int i=0; i<steps; i++) {
+    size_t before = out.data.size();
+    hostAdvanceMicros(5000);
+    lights->update();
+    if (out.data.size() != before) {
+      shown.resize(shown.size() + frameBytes);
+      g->saveFrame(&shown[shown.size() - frameBytes]);
+    }
+  }
+
+  FILE *f = fmemopen(out.data.data(), out.data.size(), "rb");
+  TraceReader t(f);
+  if (!t.ok || t.numPixels != g->numPixels()) {
+    printf("FAIL: %s: bad header\n", name);
+    failures++;
+  }
+  size_t frames = shown.size() / frameBytes;
+  unsigned long changed = 0;
+  while (!failures && t.next()) {
+    changed += (t.count != 0);
+    if (t.frames > frames) {
+      printf("FAIL: %s: more records than frames\n", name);
+      failures++;
+    } else if (memcmp(t.frame, &shown[(t.frames - 1) * frameBytes], frameBytes)) {
+      printf("FAIL: %s: frame %lu doesn't match the strips\n", name, t.frames);
+      failures++;
+    }
+  }
+  if (!failures && (!t.ok || t.frames != frames)) {
+    printf("FAIL: %s: %lu records for %zu frames\n", name, t.frames, frames);
+    failures++;
+  }
+  if (!failures && changed < 2) {
+    printf("FAIL: %s: the lights hardly changed, so that proves nothing\n", name);
+    failures++;
+  }
+  fclose(f);
+
+  lights->setFrameTrace(NULL);
+  delete trace;
+  delete lights;
+  return failures;
+}
+
+// Change the given pixels on a group of four 1000-pixel strips, and check
+// the size of the record that makes
+static int recordSize(const char *name, const pixelnum_t *changes, int n,
+		      size_t expected)
+{
+  StripGroup *g = new StripGroup();
+  for (uint8_t i=0; i<4; i++) {
+    g->addStrip(i, 1000);
+  }
+  BufferPrint out;
+  FrameTrace *trace = new FrameTrace(&out, g->numPixels());
+  trace->record(g);  // nothing changed yet
+
+  size_t before = out.data.size();
+  for (int i=0; i<n; i++) {
+    g->setPixelColor(changes[i], 0x102030);
+  }
+  trace->record(g);
+  size_t got = out.data.size() - before;
+
+  delete trace;
+  delete g;
+  if (got != expected) {
+    printf("FAIL: %s: a %zu-byte record, not %zu\n", name, got, expected);
+    return 1;
+  }
+  return 0;
+}
+
+int main()
+{
+  int failures = 0;
+
+  failures += run("twinkle", 300, 40, "T", 1, 200);
+  failures += run("dim twinkle", 300, 40, "b\xa0T", 3, 200);
+  failures += run("dim pulse", 100, 100, "b\x90" "c\xff\xa0\x40" "p", 7, 200);
+  failures += run("dim plasma", 500, 255, "b\x07P", 3, 50);
+  failures += run("80000 pixels", 40000, 40000, "h", 1, 5);
+
+  static const pixelnum_t first[] = { 5 };
+  static const pixelnum_t third[] = { 2500 };
+  static const pixelnum_t last[] = { 3999 };
+  static const pixelnum_t firstAndThird[] = { 5, 2500 };
+  failures += recordSize("no change", NULL, 0, 12);
+  failures += recordSize("one pixel, first strip", first, 1, 12 + 3);
+  failures += recordSize("one pixel, third strip", third, 1, 12 + 3);
+  failures += recordSize("the last pixel", last, 1, 12 + 3);
+  failures += recordSize("first and third strips", firstAndThird, 2, 
+			 12 + 3 * (2500 - 5 + 1));
+
+  printf("%s\n", failures ? "test_frametrace: FAILED" : "test_frametrace: ok");
+  return failures ? 1 : 0;
+}
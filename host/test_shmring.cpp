@@ -0,0 +1,189 @@
+/*
+ * ShmFrameRing: frames go through intact and readers can tell when 
+ * they've been overwritten; a new writer replaces an old ring without 
+ * pulling it out from under a reader; and a reader won't open a ring 
+ * that's smaller than its header says (or has no slots at all). And a
+ * StripGroup previewing into a ring publishes every strip's frame there,
+ * instead of showing it, once the ring is big enough for all of them.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "host.h"
+#include "../ShmFrameRing.h"
+#include "../SimpleStripLights.h"
+
+#define FRAME_BYTES 30
+
+static char name[64];
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static void writeFrame(ShmFrameRing *ring, uint8_t fill)
+{
+  uint8_t *data = ring->beginFrame();
+  memset(data, fill, ring->frameBytes());
+  ring->endFrame();
+}
+
+static bool frameIs(ShmFrameRing *ring, uint64_t frameNum, uint8_t fill)
+{
+  const uint8_t *data = ring->frameData(frameNum);
+  if (!data) {
+    return false;
+  }
+  for (uint32_t i=0; i<ring->frameBytes(); i++) {
+    if (data[i] != fill) {
+      return false;
+    }
+  }
+  return ring->isValid(frameNum);
+}
+
+// Put a ring header in place by hand, saying numSlots slots, and make the
+// object `size` bytes long
+static void fakeRing(uint32_t numSlots, uint32_t frameBytes, size_t size)
+{
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  struct _ShmFrameRingHeader h;
+  memset(&h, 0, sizeof(h));
+  h.magic = SHMFRAMERING_MAGIC;
+  h.version = SHMFRAMERING_VERSION;
+  h.numSlots = numSlots;
+  h.frameBytes = frameBytes;
+  if (fd == -1 || ftruncate(fd, size) != 0 || 
+      pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+    printf("FAIL: can't make a fake ring\n");
+    failures++;
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+static bool opens()
+{
+  ShmFrameRing reader(name);
+  return reader.isOpen();
+}
+
+// A mode's frames, on two strips, published to a ring
+static void preview()
+{
+  StripGroup *g = new StripGroup();
+  g->addStrip(1, 200);
+  g->addStrip(2, 90);
+  uint32_t frameBytes = g->numPixels() * 3;
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+
+  // Too small for both strips: refused, and the strips still show
+  ShmFrameRing *small = new ShmFrameRing(name, frameBytes - 1, 4);
+  check(!g->setPreviewOutput(small), "previewing into a ring that's too small");
+  unsigned long shows = hostShowCount;
+  g->show();
+  check(hostShowCount == shows + 2, "a refused ring stopped the strips showing");
+  delete small;
+
+  ShmFrameRing *writer = new ShmFrameRing(name, frameBytes, 4);
+  ShmFrameRing *reader = new ShmFrameRing(name);
+  check(g->setPreviewOutput(writer), "can't preview into a ring that fits");
+
+  uint8_t *expect = (uint8_t *)malloc(frameBytes);
+  uint64_t published = 0;
+  bool same = true;
+  shows = hostShowCount;
+  lights->handleCommands((const uint8_t *)"h", 1);
+  for (int i=0; i<50; i++) {
+    hostAdvanceMicros(20000);
+    lights->update();
+    if (reader->latestFrame() != published) {
+      published = reader->latestFrame();
+      g->saveFrame(expect);
+      const uint8_t *data = reader->frameData(published);
+      same = same && data && memcmp(data, expect, frameBytes) == 0 &&
+	reader->isValid(published);
+    }
+  }
+  check(published >= 10, "the mode's frames weren't published");
+  check(same, "a published frame isn't what the strips held");
+  check(hostShowCount == shows, "the strips showed while previewing");
+
+  // And back to the strips
+  g->setPreviewOutput(NULL);
+  g->show();
+  check(hostShowCount == shows + 2, "the strips don't show after previewing");
+
+  free(expect);
+  delete reader;
+  delete writer;
+  delete lights;
+  shm_unlink(name);
+}
+
+int main()
+{
+  snprintf(name, sizeof(name), "/test_shmring.%d", (int)getpid());
+  size_t slotBytes = (sizeof(struct _ShmFrameSlot) + FRAME_BYTES + 7) & ~7;
+  size_t fullSize = sizeof(struct _ShmFrameRingHeader) + 4 * slotBytes;
+
+  // No slots: no ring
+  {
+    ShmFrameRing writer(name, FRAME_BYTES, 0);
+    check(!writer.isOpen(), "a ring with no slots was created");
+    check(!opens(), "a ring with no slots can be opened");
+  }
+
+  // Frames go through, and the ones that have been lapped are gone
+  ShmFrameRing *writer = new ShmFrameRing(name, FRAME_BYTES, 4);
+  check(writer->isOpen(), "can't create a ring");
+  for (uint8_t f=1; f<=6; f++) {
+    writeFrame(writer, f);
+  }
+  ShmFrameRing *reader = new ShmFrameRing(name);
+  check(reader->isOpen(), "can't open the ring");
+  check(reader->latestFrame() == 6, "the newest frame isn't 6");
+  check(frameIs(reader, 6, 6) && frameIs(reader, 3, 3), "frames 3-6 aren't intact");
+  check(!reader->frameData(2), "frame 2 is still there after being lapped");
+
+  // A new writer of the same name starts a new ring; the reader keeps the
+  // old one, intact, until it opens the name again
+  ShmFrameRing *writer2 = new ShmFrameRing(name, FRAME_BYTES * 2, 2);
+  check(writer2->isOpen(), "can't replace a ring that's in use");
+  writeFrame(writer2, 0xAA);
+  check(frameIs(reader, 6, 6), "the old ring changed under its reader");
+  ShmFrameRing *reader2 = new ShmFrameRing(name);
+  check(reader2->isOpen() && reader2->frameBytes() == FRAME_BYTES * 2 &&
+	frameIs(reader2, 1, 0xAA), "opening again doesn't find the new ring");
+  delete reader2;
+  delete reader;
+  delete writer2;
+  delete writer;
+
+  // Rings that are shorter than they say
+  fakeRing(4, FRAME_BYTES, fullSize);
+  check(opens(), "can't open a ring made by hand");
+  fakeRing(4, FRAME_BYTES, fullSize - 1);
+  check(!opens(), "opened a ring that's a byte short");
+  fakeRing(4, FRAME_BYTES, sizeof(struct _ShmFrameRingHeader));
+  check(!opens(), "opened a ring that's only a header");
+  fakeRing(0, FRAME_BYTES, fullSize);
+  check(!opens(), "opened a ring with no slots");
+  fakeRing(1, 0xFFFFFFF0, fullSize);
+  check(!opens(), "opened a ring whose slots are too big to count");
+  shm_unlink(name);
+
+  preview();
+
+  printf("%s\n", failures ? "test_shmring: FAILED" : "test_shmring: ok");
+  return failures ? 1 : 0;
+}
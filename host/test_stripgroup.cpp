@@ -0,0 +1,127 @@
+/*
+ * The threaded StripGroup paths must draw exactly what the serial ones do:
+ * run each mode with 1 and with 4 workers and compare every frame. And
+ * strips of awkward sizes (none, too many, more than one fader's worth) 
+ * must come out the size they say they are, and run every mode (and an
+ * empty one must have nothing left to do once it's wiped).
+ */
+
+#include <stdio.h>
+#include "host.h"
+#include "../SimpleStripLights.h"
+
+static const char *modes[] = { "T", "W", "!", "t", "C", "p", "h", "s", "P",
+			       "PL\x73\x01L\x54\x02" };
+
+static uint32_t frameHash(StripGroup *g, uint8_t *buf)
+{
+  g->saveFrame(buf);
+  uint32_t h = 2166136261u;
+  for (pixelnum_t i=0; i<g->numPixels() * 3; i++) {
+    h = (h ^ buf[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void run(const char *commands, uint8_t numThreads, uint32_t *hashes, int n)
+{
+  StripGroup *g = new StripGroup();
+  // Uneven strips, several of them longer than one fader
+  g->addStrip(1, 700);
+  g->addStrip(2, 60);
+  g->addStrip(3, 1000);
+  g->addStrip(4, 255);
+  g->setWorkerThreads(numThreads);
+  uint8_t *buf = (uint8_t *)malloc(g->numPixels() * 3);
+
+  srandom(1);
+  hostSetMicros(0);
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  lights->handleCommands((const uint8_t *)commands, strlen(commands));
+  for (int i=0; i<n; i++) {
+    hostAdvanceMicros(5000);
+    lights->update();
+    hashes[i] = frameHash(g, buf);
+  }
+  delete lights;
+  free(buf);
+}
+
+// A single-pin strip of numLights pixels: its strip must hold `expected`
+// of them, a solid color must reach the last one, and every mode must run
+static int runSize(int numLights, uint16_t expected)
+{
+  int failures = 0;
+
+  hostLastStrip = NULL;
+  SimpleStripLights *lights = new SimpleStripLights(1, numLights, RawMode);
+  Adafruit_NeoPixel *strip = hostLastStrip;
+  uint16_t got = strip ? strip->numPixels() : 0;
+  if (got != expected) {
+    printf("FAIL: %d pixels: the strip has %u\n", numLights, got);
+    failures++;
+  }
+
+  lights->handleCommands((const uint8_t *)"c\x12\x34\x56" "C", 5);
+  lights->update();
+  if (got && strip->getPixelColor(got - 1) != 0x123456) {
+    printf("FAIL: %d pixels: color mode didn't reach the last one\n", numLights);
+    failures++;
+  }
+
+  for (unsigned m=0; m<sizeof(modes)/sizeof(modes[0]); m++) {
+    lights->handleCommands((const uint8_t *)modes[m], strlen(modes[m]));
+    for (int i=0; i<100; i++) {
+      hostAdvanceMicros(5000);
+      lights->update();
+    }
+  }
+
+  // An empty strip is wiped at once, and then there's nothing to do
+  if (!got) {
+    unsigned long wakeAt;
+    lights->handleCommands((const uint8_t *)"W", 1);
+    for (int i=0; i<3; i++) {
+      hostAdvanceMicros(5000);
+      lights->update();
+    }
+    if (!lights->isQuiescent(&wakeAt)) {
+      printf("FAIL: %d pixels: a wipe never finishes\n", numLights);
+      failures++;
+    }
+  }
+
+  // At the lowest brightness the faders never get anywhere, so pulse 
+  // mode's preloading has to give up on its own, past 255 pixels as well
+  lights->handleCommands((const uint8_t *)"b\x01p", 3);
+  lights->update();
+  delete lights;
+  return failures;
+}
+
+int main()
+{
+  const int n = 400;
+  uint32_t serial[n], threaded[n];
+  int failures = 0;
+
+  hostShowMicrosPerPixel = 0;
+  for (unsigned m=0; m<sizeof(modes)/sizeof(modes[0]); m++) {
+    run(modes[m], 1, serial, n);
+    run(modes[m], 4, threaded, n);
+    for (int i=0; i<n; i++) {
+      if (serial[i] != threaded[i]) {
+	printf("FAIL: mode '%c': frame %d differs with 4 workers\n", modes[m][0], i);
+	failures++;
+	break;
+      }
+    }
+  }
+  failures += runSize(300, 300);
+  failures += runSize(0, 0);
+  failures += runSize(-1, 0);
+  failures += runSize(70000, 0);
+
+  printf("%s\n", failures ? "test_stripgroup: FAILED" : "test_stripgroup: ok");
+  return failures ? 1 : 0;
+}
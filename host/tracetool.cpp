@@ -0,0 +1,214 @@
+/*
+ * Makes and picks apart FrameTrace streams (see ../FrameTrace.h).
+ *
+ *   tracetool record <trace> <pixels> <ms> <commands>
+ *       run the lights on <pixels> pixels for <ms> of virtual time, after
+ *       sending them <commands> (\xNN escapes allowed), and trace them
+ *   tracetool info <trace>
+ *       frames, changes and the intervals between frames
+ *   tracetool curve <trace> <pixel>
+ *       one pixel's color in every frame that changed it: a fade curve
+ *   tracetool diff <trace> <trace>
+ *       the first frame where two traces differ, and how many do
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "TraceReader.h"
+#include "../SimpleStripLights.h"
+
+static FILE *openTrace(const char *name, const char *how)
+{
+  FILE *f = fopen(name, how);
+  if (!f) {
+    perror(name);
+    exit(2);
+  }
+  return f;
+}
+
+static size_t unescape(const char *s, uint8_t *out)
+{
+  size_t n = 0;
+  while (*s) {
+    if (s[0] == '\\' && s[1] == 'x' && s[2] && s[3]) {
+      char hex[3] = { s[2], s[3], 0 };
+      out[n++] = strtoul(hex, NULL, 16);
+      s += 4;
+    } else {
+      out[n++] = *s++;
+    }
+  }
+  return n;
+}
+
+static int record(const char *name, int numPixels, unsigned long ms, 
+		  const char *commands)
+{
+  FILE *f = openTrace(name, "wb");
+  HostFilePrint out(f);
+
+  srandom(1);
+  hostSetMicros(0);
+  StripGroup *g = new StripGroup();
+  g->addStrip(1, numPixels);
+  SimpleStripLights *lights = new SimpleStripLights(g, RawMode);
+  FrameTrace *trace = new FrameTrace(&out, g->numPixels());
+  lights->setFrameTrace(trace);
+
+  uint8_t *buf = (uint8_t *)malloc(strlen(commands) + 1);
+  lights->handleCommands(buf, unescape(commands, buf));
+  free(buf);
+  while (millis() < ms) {
+    lights->update();
+    hostAdvanceMicros(1000);
+  }
+
+  lights->setFrameTrace(NULL);
+  delete trace;
+  delete lights;
+  fclose(f);
+  return 0;
+}
+
+static int info(const char *name)
+{
+  FILE *f = openTrace(name, "rb");
+  TraceReader t(f);
+  if (!t.ok) {
+    return 2;
+  }
+
+  // Intervals in buckets of 0, 1, 2-3, 4-7, ... ms
+  unsigned long buckets[33] = { 0 };
+  unsigned long changed = 0, pixels = 0;
+  uint32_t start = 0, prev = 0, minGap = 0xFFFFFFFF, maxGap = 0;
+  while (t.next()) {
+    if (t.frames == 1) {
+      start = t.millis;
+    } else {
+      uint32_t gap = t.millis - prev;
+      minGap = min(minGap, gap);
+      maxGap = max(maxGap, gap);
+      uint8_t b = 0;
+      while (gap >> b) {
+	b++;
+      }
+      buckets[b]++;
+    }
+    prev = t.millis;
+    if (t.count) {
+      changed++;
+      pixels += t.count;
+    }
+  }
+
+  printf("%u pixels, %lu frames over %u ms%s\n", t.numPixels, t.frames,
+	 prev - start, t.ok ? "" : " (truncated)");
+  printf("%lu frames changed something, %.1f pixels per record on average\n",
+	 changed, changed ? (double)pixels / changed : 0.0);
+  if (t.frames > 1) {
+    printf("frame interval: min %u ms, mean %.2f ms, max %u ms\n", minGap,
+	   (double)(prev - start) / (t.frames - 1), maxGap);
+    for (uint8_t b=0; b<33; b++) {
+      if (buckets[b]) {
+	uint32_t lo = b ? 1UL << (b - 1) : 0;
+	uint32_t hi = b ? (lo << 1) - 1 : 0;
+	printf("  %6u-%-6u ms: %lu\n", lo, hi, buckets[b]);
+      }
+    }
+  }
+  fclose(f);
+  return t.ok ? 0 : 1;
+}
+
+static int curve(const char *name, uint32_t pixel)
+{
+  FILE *f = openTrace(name, "rb");
+  TraceReader t(f);
+  if (!t.ok) {
+    return 2;
+  }
+  if (pixel >= t.numPixels) {
+    fprintf(stderr, "the trace only has %u pixels\n", t.numPixels);
+    return 2;
+  }
+
+  printf("# ms R G B\n");
+  uint32_t last = 0;
+  while (t.next()) {
+    uint32_t c = t.pixel(pixel);
+    if (t.frames == 1 || c != last) {
+      printf("%u %u %u %u\n", t.millis, (c >> 16) & 0xFF, (c >> 8) & 0xFF, 
+	     c & 0xFF);
+      last = c;
+    }
+  }
+  fclose(f);
+  return t.ok ? 0 : 1;
+}
+
+static int diff(const char *nameA, const char *nameB)
+{
+  FILE *fa = openTrace(nameA, "rb");
+  FILE *fb = openTrace(nameB, "rb");
+  TraceReader a(fa), b(fb);
+  if (!a.ok || !b.ok) {
+    return 2;
+  }
+  if (a.numPixels != b.numPixels) {
+    printf("%u pixels vs %u\n", a.numPixels, b.numPixels);
+    return 1;
+  }
+
+  unsigned long differing = 0;
+  bool moreA, moreB;
+  while ((moreA = a.next()) & (moreB = b.next())) {
+    if (memcmp(a.frame, b.frame, a.numPixels * 3) == 0) {
+      continue;
+    }
+    if (!differing) {
+      uint32_t p = 0;
+      while (a.pixel(p) == b.pixel(p)) {
+	p++;
+      }
+      printf("first difference: frame %lu (%u ms vs %u ms), pixel %u: "
+	     "%06x vs %06x\n", a.frames, a.millis, b.millis, p,
+	     a.pixel(p), b.pixel(p));
+    }
+    differing++;
+  }
+  if (moreA || moreB) {
+    printf("%s has more frames (%lu vs %lu compared)\n", 
+	   moreA ? nameA : nameB, a.frames, b.frames);
+  }
+  if (differing) {
+    printf("%lu frames differ\n", differing);
+  }
+  fclose(fa);
+  fclose(fb);
+  return (differing || moreA || moreB) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 6 && !strcmp(argv[1], "record")) {
+    return record(argv[2], atoi(argv[3]), strtoul(argv[4], NULL, 0), argv[5]);
+  }
+  if (argc == 3 && !strcmp(argv[1], "info")) {
+    return info(argv[2]);
+  }
+  if (argc == 4 && !strcmp(argv[1], "curve")) {
+    return curve(argv[2], strtoul(argv[3], NULL, 0));
+  }
+  if (argc == 4 && !strcmp(argv[1], "diff")) {
+    return diff(argv[2], argv[3]);
+  }
+  fprintf(stderr, 
+	  "usage: tracetool record <trace> <pixels> <ms> <commands>\n"
+	  "       tracetool info <trace>\n"
+	  "       tracetool curve <trace> <pixel>\n"
+	  "       tracetool diff <trace> <trace>\n");
+  return 2;
+}
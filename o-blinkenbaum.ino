@@ -6,6 +6,10 @@
 #include <WirelessHEX69.h> //get it here: https://github.com/LowPowerLab/WirelessProgramming/tree/master/WirelessHEX69
 #include <RingBuffer.h>    //get it here: https://github.com/JorjBauer/RingBuffer
 #include "SimpleStripLights.h"
+#include "SerialInput.h"
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
 
 #define NODEID             11
 #define NETWORKID          212
@@ -26,6 +30,7 @@ SPIFlash flash(FLASH_SS, 0xEF30); //EF30 for windbond 4mbit flash
 #define TOTAL_LEDS 150
 
 SimpleStripLights *lights;
+SerialInput *serialInput;
 
 bool respondToBroadcast = true;
 
@@ -42,6 +47,25 @@ void setup() {
   flash.initialize();
 
   lights = new SimpleStripLights(WS2812PIN, TOTAL_LEDS, TwinkleMode, 0x000000F0, 0x00FFFFC4);
+  serialInput = new SerialInput(&Serial, lights);
+}
+
+// Idle the CPU until the next interrupt, unless there's already serial 
+// input waiting or wakeAt has come. Idle sleep keeps the radio interrupt, 
+// the UART and the millis() timer running, so we wake for a radio packet, 
+// a serial byte, or the next millisecond tick, and loop() checks again.
+void sleepUntil(unsigned long wakeAt) {
+#ifdef __AVR__
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  noInterrupts();
+  if (Serial.available() == 0 && millis() < wakeAt) {
+    sleep_enable();
+    interrupts(); // the instruction after this one always runs first
+    sleep_cpu();
+    sleep_disable();
+  }
+  interrupts();
+#endif
 }
 
 void loop() {
@@ -73,13 +97,20 @@ void loop() {
 
   }
 
-  if (Serial.available() > 0) {
-    byte b = Serial.read();
-    lights->handleCommands(&b, 1);
+  // Take whatever's waiting on the serial port. While bytes it has let the
+  // host send are still on their way, hold off on update(): a show() would
+  // have interrupts off, and they'd be lost.
+  serialInput->poll();
+  if (serialInput->isReceiving()) {
+    return;
   }
 
-
   lights->update();
+
+  unsigned long wakeAt;
+  if (lights->isQuiescent(&wakeAt)) {
+    sleepUntil(wakeAt);
+  }
 }
 
 